@@ -16,6 +16,22 @@ cd ./Assets
 zip -FSr ../Bin/Release-Linux/assets.zip .
 popd
 
+#The pack is read in place of assets.zip when it exists. With --cook-textures, images in it are replaced by
+# cooked textures that keep their names, so that they are loaded without decoding them or generating mipmaps.
+#This is opt-in since only the Texture2D loader can read the cooked files, other code reading the images would break.
+if test -x "$JAMLIB_DIR/Bin/Release-Linux/assetpacker"
+	rm -rf .build/CookedAssets
+	cp -r ./Assets .build/CookedAssets
+	
+	if contains -- --cook-textures $argv
+		for image in (find .build/CookedAssets -type f \( -name '*.png' -o -name '*.jpg' -o -name '*.jpeg' -o -name '*.tga' \))
+			$JAMLIB_DIR/Bin/Release-Linux/texturecooker $image $image
+		end
+	end
+	
+	$JAMLIB_DIR/Bin/Release-Linux/assetpacker .build/CookedAssets Bin/Release-Linux/assets.pack
+end
+
 if test -d "$JAMLIB_DIR/CMake/Release-Windows"
 	if test -f "./Assets/JMGameIcon.png"
 		convert ./Assets/JMGameIcon.png .build/Release-Win32/icon.ico
@@ -29,6 +45,9 @@ if test -d "$JAMLIB_DIR/CMake/Release-Windows"
 	make -j4 -C .build/Release-Win32
 	
 	cp Bin/Release-Linux/assets.zip Bin/Release-Windows/assets.zip
+	if test -f Bin/Release-Linux/assets.pack
+		cp Bin/Release-Linux/assets.pack Bin/Release-Windows/assets.pack
+	end
 	cp /usr/x86_64-w64-mingw32/bin/libgcc_s_seh-1.dll Bin/Release-Windows
 	cp /usr/x86_64-w64-mingw32/bin/libstdc++-6.dll Bin/Release-Windows
 	cp /usr/x86_64-w64-mingw32/bin/libwinpthread-1.dll Bin/Release-Windows
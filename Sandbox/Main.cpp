@@ -1,5 +1,31 @@
 #include "JamLib.hpp"
 
+//Times the ways of getting an asset, printing the average time per lookup
+static void RunAssetLookupBenchmark()
+{
+	constexpr int NUM_LOOKUPS = 1000000;
+	static constexpr jm::AssetID PLAYER_ID("Player.png");
+	
+	const jm::AssetRef<jm::Texture2D> playerRef(PLAYER_ID);
+	
+	auto Measure = [] (const char* label, auto getAsset)
+	{
+		//Summing the widths keeps the lookups from being optimized away
+		uint64_t widthSum = 0;
+		const int64_t startTime = jm::NanoTime();
+		for (int i = 0; i < NUM_LOOKUPS; i++)
+		{
+			widthSum += getAsset().Width();
+		}
+		const int64_t elapsed = jm::NanoTime() - startTime;
+		std::cout << label << ": " << (double)elapsed / NUM_LOOKUPS << " ns per lookup (" << widthSum << ")" << std::endl;
+	};
+	
+	Measure("GetAsset(name)", [] () -> jm::Texture2D& { return jm::GetAsset<jm::Texture2D>("Player.png"); });
+	Measure("GetAsset(AssetID)", [] () -> jm::Texture2D& { return jm::GetAsset<jm::Texture2D>(PLAYER_ID); });
+	Measure("AssetRef", [&] () -> jm::Texture2D& { return *playerRef; });
+}
+
 struct Game : jm::Game
 {
 	Game()
@@ -23,6 +49,9 @@ struct Game : jm::Game
 	
 	void RunFrame(float dt) override
 	{
+		if (jm::IsButtonDownNow(jm::Button::B))
+			RunAssetLookupBenchmark();
+		
 		if (jm::IsButtonDown(jm::Button::LeftArrow))
 			vx -= dt * 200;
 		else if (jm::IsButtonDown(jm::Button::RightArrow))
@@ -1,16 +1,58 @@
 #include "Asset.hpp"
 #include "Utils.hpp"
+#include "SPSCQueue.hpp"
 
 #include <unordered_map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #ifdef __linux__
 #include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
 #endif
 
 namespace jm
 {
 	std::vector<detail::AssetLoader> detail::assetLoaders;
 	
+	enum class LoadState
+	{
+		Unloaded,
+		Queued,
+		Reading,
+		Read,
+		Loaded
+	};
+	
+	//Guards the load state of assets and the queues shared with the loading threads.
+	static std::mutex loadMutex;
+	static std::condition_variable queueSignal;
+	static std::condition_variable readSignal;
+	static std::deque<size_t> loadQueue;
+	static std::deque<size_t> readQueue;
+	static std::vector<std::thread> loadThreads;
+	static bool stopLoading = false;
+	static size_t numLoadedAssets = 0;
+	
+	//The number of assets that are queued for loading or are being loaded by the loading threads.
+	static size_t numPendingAssets = 0;
+	
+	static AssetLoadMode loadMode = AssetLoadMode::Eager;
+	
+	//Total memory used by loaded assets, and the budget it should stay within (0 if there is none).
+	static size_t loadedAssetBytes = 0;
+	static size_t assetMemoryBudget = 0;
+	
+	//Incremented whenever an asset is used, to find the least recently used assets.
+	static uint64_t assetUseCounter = 0;
+	
 	struct Asset
 	{
 		std::string name;
@@ -18,16 +60,36 @@ namespace jm
 		void* assetMemory;
 		bool loaded;
 		size_t loaderIndex;
-		std::function<std::vector<char>()> readCallback;
+		std::function<detail::AssetData()> readCallback;
 		std::chrono::system_clock::time_point loadTime;
 		std::vector<std::function<void(void*)>> initCallbacks;
 		
+		//Indices of the assets that got this asset while they were being created, which are reloaded after this asset.
+		std::vector<size_t> dependents;
+		
+		AssetMemoryUsage memoryUsage;
+		uint64_t lastUse = 0;
+		
+		//Set once the asset has been returned by GetAsset, which means it must not be evicted.
+		bool pinned = false;
+		
+		//Written by the thread that reads the asset, until it sets state to Read.
+		//States other than Unloaded and Loaded count towards numPendingAssets.
+		LoadState state = LoadState::Unloaded;
+		detail::AssetData data;
+		std::any decoded;
+		
 		void Unload()
 		{
 			if (loaded)
 			{
 				detail::assetLoaders[loaderIndex].destructor(assetMemory);
 				loaded = false;
+				numLoadedAssets--;
+				loadedAssetBytes -= memoryUsage.Total();
+				
+				std::lock_guard<std::mutex> lock(loadMutex);
+				state = LoadState::Unloaded;
 			}
 		}
 		
@@ -44,6 +106,26 @@ namespace jm
 	
 	static std::vector<Asset> assets;
 	
+	//The number of AssetRefs to each asset, separate from assets since atomics can't be moved.
+	static std::unique_ptr<std::atomic<uint32_t>[]> assetRefCounts;
+	
+	//Maps the HashFNV1a64 of asset names to their index in assets.
+	static std::unordered_map<uint64_t, size_t> assetIndices;
+	
+	//Indices of the assets being created on the main thread, innermost last.
+	static std::vector<size_t> creatingAssets;
+	
+	//Records that the asset being created, if any, uses another asset.
+	static void TrackAssetUse(size_t index)
+	{
+		if (creatingAssets.empty())
+			return;
+		
+		std::vector<size_t>& dependents = assets[index].dependents;
+		if (std::find(dependents.begin(), dependents.end(), creatingAssets.back()) == dependents.end())
+			dependents.push_back(creatingAssets.back());
+	}
+	
 	static int64_t FindAssetLoader(std::string_view name)
 	{
 		size_t lastDot = name.rfind('.');
@@ -53,14 +135,15 @@ namespace jm
 		
 		for (int64_t i = (int64_t)detail::assetLoaders.size() - 1; i >= 0; i--)
 		{
-			if (ext == detail::assetLoaders[i].extension)
+			const detail::AssetLoader& loader = detail::assetLoaders[i];
+			if (ext == loader.extension && StringStartsWith(name, loader.namePrefix))
 				return i;
 		}
 		
 		return -1;
 	}
 	
-	static void ProcessAsset(std::string name, std::string source, std::function<std::vector<char>()> readCallback)
+	static void ProcessAsset(std::string name, std::string source, std::function<detail::AssetData()> readCallback)
 	{
 		int64_t loader = FindAssetLoader(name);
 		if (loader == -1)
@@ -78,21 +161,48 @@ namespace jm
 	
 	static std::unique_ptr<char[]> assetMemory;
 	
-	inline void LoadAsset(Asset& asset)
+	//Reads and decodes an asset, this can run on any thread.
+	static void ReadAsset(Asset& asset)
 	{
-		if (asset.loaded)
-			return;
+		detail::AssetData data = asset.readCallback();
+		
+		const detail::AssetLoader& loader = detail::assetLoaders[asset.loaderIndex];
+		if (loader.decodeCallback)
+			asset.decoded = loader.decodeCallback(data.data, asset.name);
+		else
+			asset.data = std::move(data);
+	}
+	
+	//Creates an asset from the data read by ReadAsset, on the main thread.
+	static void CreateAsset(Asset& asset)
+	{
+		const detail::AssetLoader& loader = detail::assetLoaders[asset.loaderIndex];
 		
-		std::vector<char> data = asset.readCallback();
+		creatingAssets.push_back(&asset - assets.data());
+		if (loader.decodeCallback)
+		{
+			loader.createCallback(asset.decoded, asset.name, asset.assetMemory);
+			asset.decoded.reset();
+		}
+		else
+		{
+			loader.loadCallback(asset.data.data, asset.name, asset.assetMemory);
+			asset.data = { };
+		}
 		
-		detail::assetLoaders[asset.loaderIndex].loadCallback(data, asset.name, asset.assetMemory);
+		creatingAssets.pop_back();
 		
 		asset.loadTime = std::chrono::system_clock::now();
 		asset.loaded = true;
+		numLoadedAssets++;
+		
+		asset.memoryUsage = loader.memoryUsageCallback ?
+			loader.memoryUsageCallback(asset.assetMemory) : AssetMemoryUsage { loader.typeSize, 0, 0 };
+		loadedAssetBytes += asset.memoryUsage.Total();
 		
-		if (asset.source.empty())
 		{
-			asset.readCallback = nullptr;
+			std::lock_guard<std::mutex> lock(loadMutex);
+			asset.state = LoadState::Loaded;
 		}
 		
 		for (const std::function<void(void*)>& initCallback : asset.initCallbacks)
@@ -101,9 +211,74 @@ namespace jm
 		}
 	}
 	
+	static void LoadAsset(Asset& asset)
+	{
+		if (asset.loaded)
+			return;
+		
+		std::unique_lock<std::mutex> lock(loadMutex);
+		const bool wasPending = asset.state != LoadState::Unloaded;
+		if (asset.state == LoadState::Reading)
+		{
+			//Waits for the loading thread instead of reading the asset again
+			readSignal.wait(lock, [&] { return asset.state != LoadState::Reading; });
+		}
+		if (asset.state == LoadState::Unloaded || asset.state == LoadState::Queued)
+		{
+			asset.state = LoadState::Reading;
+			lock.unlock();
+			ReadAsset(asset);
+			lock.lock();
+			asset.state = LoadState::Read;
+		}
+		if (wasPending)
+			numPendingAssets--;
+		lock.unlock();
+		
+		CreateAsset(asset);
+	}
+	
+	//Queues an asset for the loading threads, loadMutex must be locked.
+	static void QueueAsset(size_t index)
+	{
+		if (assets[index].state == LoadState::Unloaded)
+		{
+			assets[index].state = LoadState::Queued;
+			loadQueue.push_back(index);
+			numPendingAssets++;
+		}
+	}
+	
+	static void LoadThreadMain()
+	{
+		std::unique_lock<std::mutex> lock(loadMutex);
+		while (true)
+		{
+			queueSignal.wait(lock, [] { return stopLoading || !loadQueue.empty(); });
+			if (stopLoading)
+				return;
+			
+			const size_t index = loadQueue.front();
+			loadQueue.pop_front();
+			
+			//The main thread may have loaded the asset itself while it was queued
+			Asset& asset = assets[index];
+			if (asset.state != LoadState::Queued)
+				continue;
+			
+			asset.state = LoadState::Reading;
+			lock.unlock();
+			ReadAsset(asset);
+			lock.lock();
+			asset.state = LoadState::Read;
+			readQueue.push_back(index);
+			readSignal.notify_all();
+		}
+	}
+	
 	void detail::LoadAssets()
 	{
-		if (!FindAssetsDir(ProcessAsset) && !FindAssetsZip(ProcessAsset))
+		if (!FindAssetsDir(ProcessAsset) && !FindAssetsPack(ProcessAsset) && !FindAssetsZip(ProcessAsset))
 		{
 			return;
 		}
@@ -128,62 +303,485 @@ namespace jm
 			assets[i].assetMemory = assetMemory.get() + assetMemoryOffset[i];
 		}
 		
+		assetRefCounts = std::make_unique<std::atomic<uint32_t>[]>(assets.size());
+		
+		assetIndices.reserve(assets.size());
+		for (size_t i = 0; i < assets.size(); i++)
+		{
+			auto [it, inserted] = assetIndices.emplace(HashFNV1a64(assets[i].name), i);
+			if (!inserted)
+			{
+				Panic(Concat({ "Asset names '", assets[it->second].name, "' and '", assets[i].name,
+					"' have the same hash, rename one of them." }));
+			}
+		}
+		
+		if (loadMode == AssetLoadMode::Eager)
+		{
+			std::lock_guard<std::mutex> lock(loadMutex);
+			for (size_t i = 0; i < assets.size(); i++)
+				QueueAsset(i);
+		}
+		
+		//Without threads, assets are loaded on the main thread by UpdateAssetLoading instead
+#ifndef __EMSCRIPTEN__
+		const uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2U) - 1;
+		for (uint32_t i = 0; i < numThreads; i++)
+		{
+			loadThreads.emplace_back(&LoadThreadMain);
+		}
+#endif
+	}
+	
+	//Unloads assets without references, least recently used first, until loaded assets fit within the budget.
+	static void EvictAssets()
+	{
+		if (assetMemoryBudget == 0 || loadedAssetBytes <= assetMemoryBudget)
+			return;
+		
+		std::vector<size_t> candidates;
+		for (size_t i = 0; i < assets.size(); i++)
+		{
+			if (assets[i].loaded && !assets[i].pinned && assetRefCounts[i].load(std::memory_order_acquire) == 0)
+				candidates.push_back(i);
+		}
+		
+		std::sort(candidates.begin(), candidates.end(), [&] (size_t a, size_t b)
+		{
+			return assets[a].lastUse < assets[b].lastUse;
+		});
+		
+		for (size_t index : candidates)
+		{
+			if (loadedAssetBytes <= assetMemoryBudget)
+				break;
+			assets[index].Unload();
+		}
+	}
+	
+	void detail::UpdateAssetLoading(int64_t timeLimitNS)
+	{
+		EvictAssets();
+		
+		const int64_t startTime = NanoTime();
+		do
+		{
+			size_t index;
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				std::deque<size_t>& queue = loadThreads.empty() ? loadQueue : readQueue;
+				if (queue.empty())
+					return;
+				index = queue.front();
+				queue.pop_front();
+				
+				//Skips assets that have been unloaded since they were queued
+				if (assets[index].state == LoadState::Unloaded)
+					continue;
+			}
+			
+			LoadAsset(assets[index]);
+		} while (NanoTime() - startTime < timeLimitNS);
+	}
+	
+#ifdef __linux__
+	//Asset files are watched with inotify on a background thread, which passes the indices of changed assets
+	// to the main thread. Written before the thread starts and only read afterwards.
+	static int watchFd = -1;
+	static int watchStopFd = -1;
+	static std::unordered_map<int, std::string> watchedDirectories;
+	static std::unordered_map<std::string, size_t> assetsBySource;
+	
+	static std::thread watchThread;
+	static bool watchStarted = false;
+	static SPSCQueue<size_t> changedAssets(1024);
+	
+	//Set if changes were missed, in which case all assets are checked for changes instead.
+	static std::atomic_bool changedAssetsOverflowed { false };
+	
+	static void WatchThreadMain()
+	{
+		alignas(inotify_event) char buffer[4096];
+		pollfd pollFds[2] = { { watchFd, POLLIN, 0 }, { watchStopFd, POLLIN, 0 } };
+		
+		while (true)
+		{
+			if (poll(pollFds, 2, -1) < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return;
+			}
+			
+			if (pollFds[1].revents != 0)
+				return;
+			if (pollFds[0].revents == 0)
+				continue;
+			
+			const ssize_t length = read(watchFd, buffer, sizeof(buffer));
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+				
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					changedAssetsOverflowed.store(true, std::memory_order_relaxed);
+					continue;
+				}
+				
+				auto dirIt = watchedDirectories.find(event->wd);
+				if (dirIt == watchedDirectories.end() || event->len == 0)
+					continue;
+				
+				auto assetIt = assetsBySource.find(dirIt->second + event->name);
+				if (assetIt != assetsBySource.end() && !changedAssets.Push(assetIt->second))
+					changedAssetsOverflowed.store(true, std::memory_order_relaxed);
+			}
+		}
+	}
+	
+	static void StartWatchingAssets()
+	{
+		watchStarted = true;
+		watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		watchStopFd = eventfd(0, EFD_CLOEXEC);
+		if (watchFd == -1 || watchStopFd == -1)
+		{
+			std::cerr << "Could not watch assets for changes, checking every asset each frame instead.\n";
+			return;
+		}
+		
+		std::unordered_map<std::string_view, int> watchesByDirectory;
+		for (size_t i = 0; i < assets.size(); i++)
+		{
+			if (assets[i].source.empty())
+				continue;
+			assetsBySource.emplace(assets[i].source, i);
+			
+			//Saving through a temporary file which replaces the asset shows up as IN_MOVED_TO
+			const std::string_view directory = ParentPath(assets[i].source, true);
+			if (watchesByDirectory.count(directory) == 0)
+			{
+				const int wd = inotify_add_watch(watchFd, std::string(directory).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+				watchesByDirectory.emplace(directory, wd);
+				if (wd != -1)
+					watchedDirectories.emplace(wd, directory);
+			}
+		}
+		
+		watchThread = std::thread(&WatchThreadMain);
+	}
+	
+	static void StopWatchingAssets()
+	{
+		if (watchThread.joinable())
+		{
+			const uint64_t stopValue = 1;
+			if (write(watchStopFd, &stopValue, sizeof(stopValue)) == sizeof(stopValue))
+				watchThread.join();
+			else
+				watchThread.detach();
+		}
+		
+		if (watchFd != -1)
+			close(watchFd);
+		if (watchStopFd != -1)
+			close(watchStopFd);
+		watchFd = watchStopFd = -1;
+	}
+	
+	//Finds changed assets by comparing the modification time of every asset file to when it was loaded.
+	static void FindChangedAssetsByTime(std::vector<size_t>& changedOut)
+	{
+		for (size_t i = 0; i < assets.size(); i++)
+		{
+			if (assets[i].source.empty() || !assets[i].loaded)
+				continue;
+			
+			struct stat attrib;
+			stat(assets[i].source.c_str(), &attrib);
+			auto lastWriteTime = std::chrono::system_clock::from_time_t(attrib.st_mtime);
+			
+			if (lastWriteTime > assets[i].loadTime)
+				changedOut.push_back(i);
+		}
+	}
+#endif
+	
+	void detail::StopAssetLoading()
+	{
+#ifdef __linux__
+		StopWatchingAssets();
+#endif
+		
+		{
+			std::lock_guard<std::mutex> lock(loadMutex);
+			stopLoading = true;
+		}
+		queueSignal.notify_all();
+		
+		for (std::thread& thread : loadThreads)
+			thread.join();
+		loadThreads.clear();
+	}
+	
+	AssetLoadProgress GetAssetLoadProgress()
+	{
+		std::lock_guard<std::mutex> lock(loadMutex);
+		return AssetLoadProgress { numLoadedAssets, numLoadedAssets + numPendingAssets };
+	}
+	
+	void WaitForAssets()
+	{
 		for (Asset& asset : assets)
 		{
-			LoadAsset(asset);
+			std::unique_lock<std::mutex> lock(loadMutex);
+			const bool pending = asset.state != LoadState::Unloaded && asset.state != LoadState::Loaded;
+			lock.unlock();
+			
+			if (pending)
+				LoadAsset(asset);
 		}
 	}
 	
-	static inline Asset& FindAsset(std::string_view name, const std::type_index* type)
+	void SetAssetLoadMode(AssetLoadMode mode)
 	{
+		loadMode = mode;
+	}
+	
+	//Gets the range of assets whose names start with a prefix.
+	static std::pair<std::vector<Asset>::iterator, std::vector<Asset>::iterator> FindAssetsWithPrefix(std::string_view prefix)
+	{
+		std::string prefixCanon = CanonicalPath(prefix);
+		if (!prefixCanon.empty() && !prefix.empty() && prefix.back() == '/')
+			prefixCanon.push_back('/');
+		
+		auto begin = std::lower_bound(assets.begin(), assets.end(), prefixCanon);
+		auto end = begin;
+		while (end != assets.end() && end->name.compare(0, prefixCanon.size(), prefixCanon) == 0)
+			++end;
+		return { begin, end };
+	}
+	
+	void PreloadAssets(std::string_view prefix)
+	{
+		auto [begin, end] = FindAssetsWithPrefix(prefix);
+		
+		std::lock_guard<std::mutex> lock(loadMutex);
+		for (auto it = begin; it != end; ++it)
+			QueueAsset(it - assets.begin());
+		queueSignal.notify_all();
+	}
+	
+	void UnloadAssets(std::string_view prefix)
+	{
+		auto [begin, end] = FindAssetsWithPrefix(prefix);
+		for (auto it = begin; it != end; ++it)
+		{
+			it->pinned = false;
+			if (it->loaded)
+			{
+				it->Unload();
+				continue;
+			}
+			
+			//Cancels loading, or throws away the data if the asset has already been read
+			std::unique_lock<std::mutex> lock(loadMutex);
+			readSignal.wait(lock, [&] { return it->state != LoadState::Reading; });
+			if (it->state != LoadState::Unloaded)
+			{
+				it->state = LoadState::Unloaded;
+				it->data = { };
+				it->decoded.reset();
+				numPendingAssets--;
+			}
+		}
+	}
+	
+	static size_t FindAssetIndex(std::string_view name)
+	{
+		//Names are usually canonical already, in which case they can be looked up without building the canonical path
+		auto it = assetIndices.find(HashFNV1a64(name));
+		if (it != assetIndices.end() && assets[it->second].name == name)
+			return it->second;
+		
 		std::string nameCanon = CanonicalPath(name);
-		auto it = std::lower_bound(assets.begin(), assets.end(), nameCanon);
-		if (it == assets.end() || it->name != nameCanon)
+		it = assetIndices.find(HashFNV1a64(nameCanon));
+		if (it == assetIndices.end() || assets[it->second].name != nameCanon)
 		{
 			Panic(Concat({ "Asset not found: '", name, "'." }));
 		}
-		if (type != nullptr && detail::assetLoaders[it->loaderIndex].typeIndex != *type)
+		return it->second;
+	}
+	
+	static inline Asset& FindAsset(std::string_view name, const std::type_index* type)
+	{
+		Asset& asset = assets[FindAssetIndex(name)];
+		if (type != nullptr && detail::assetLoaders[asset.loaderIndex].typeIndex != *type)
 		{
 			Panic(Concat({ "Attempted to get asset '", name, "' as an incorrect type." }));
 		}
-		return *it;
+		return asset;
 	}
 	
 	void* detail::GetAsset(std::string_view name, std::type_index type)
 	{
 		Asset& asset = FindAsset(name, &type);
+		asset.pinned = true;
+		return GetAssetByIndex(&asset - assets.data());
+	}
+	
+	size_t detail::FindAssetIndex(std::string_view name, std::type_index type)
+	{
+		return &FindAsset(name, &type) - assets.data();
+	}
+	
+	size_t detail::FindAssetIndex(AssetID id, std::type_index type)
+	{
+		auto it = assetIndices.find(id.hash);
+		if (it == assetIndices.end())
+		{
+			Panic("Asset not found for AssetID " + std::to_string(id.hash) + ".");
+		}
+		if (assetLoaders[assets[it->second].loaderIndex].typeIndex != type)
+		{
+			Panic(Concat({ "Attempted to get asset '", assets[it->second].name, "' as an incorrect type." }));
+		}
+		return it->second;
+	}
+	
+	void* detail::GetAsset(AssetID id, std::type_index type)
+	{
+		const size_t index = FindAssetIndex(id, type);
+		assets[index].pinned = true;
+		return GetAssetByIndex(index);
+	}
+	
+	void* detail::GetAssetByIndex(size_t index)
+	{
+		Asset& asset = assets[index];
+		asset.lastUse = ++assetUseCounter;
+		TrackAssetUse(index);
 		LoadAsset(asset);
 		return asset.assetMemory;
 	}
 	
+	void detail::AcquireAssetRef(size_t index)
+	{
+		assetRefCounts[index].fetch_add(1, std::memory_order_relaxed);
+	}
+	
+	void detail::ReleaseAssetRef(size_t index)
+	{
+		assetRefCounts[index].fetch_sub(1, std::memory_order_release);
+	}
+	
+	std::vector<AssetTypeMemoryUsage> GetAssetMemoryUsage()
+	{
+		std::vector<AssetTypeMemoryUsage> usageByType;
+		for (const Asset& asset : assets)
+		{
+			if (!asset.loaded)
+				continue;
+			
+			const std::type_index type = detail::assetLoaders[asset.loaderIndex].typeIndex;
+			auto it = std::find_if(usageByType.begin(), usageByType.end(), [&] (const AssetTypeMemoryUsage& typeUsage)
+			{
+				return typeUsage.type == type;
+			});
+			if (it == usageByType.end())
+				it = usageByType.insert(it, AssetTypeMemoryUsage { type, 0, { } });
+			
+			it->numLoaded++;
+			it->usage += asset.memoryUsage;
+		}
+		return usageByType;
+	}
+	
+	AssetMemoryUsage GetTotalAssetMemoryUsage()
+	{
+		AssetMemoryUsage total;
+		for (const Asset& asset : assets)
+		{
+			if (asset.loaded)
+				total += asset.memoryUsage;
+		}
+		return total;
+	}
+	
+	void SetAssetMemoryBudget(size_t bytes)
+	{
+		assetMemoryBudget = bytes;
+	}
+	
 	void detail::InitAssetCallback(std::string_view name, std::type_index type, std::function<void(void*)> callback)
 	{
 		Asset& asset = FindAsset(name, &type);
 		if (asset.loaded)
 			callback(asset.assetMemory);
-		if (!asset.source.empty())
-			asset.initCallbacks.push_back(std::move(callback));
+		
+		//Kept for every asset, since assets that are still loading or have been unloaded are created later
+		asset.initCallbacks.push_back(std::move(callback));
 	}
 	
-	void detail::PollChangedAssets()
+	//Adds the assets that used an asset while being created to order, after the assets that use them in turn.
+	static void VisitDependents(size_t index, std::vector<bool>& visited, std::vector<size_t>& order)
 	{
-#ifdef __linux__
-		for (Asset& asset : assets)
+		if (visited[index])
+			return;
+		visited[index] = true;
+		
+		for (size_t dependent : assets[index].dependents)
+			VisitDependents(dependent, visited, order);
+		order.push_back(index);
+	}
+	
+	//Reloads changed assets and the assets that depend on them, with each asset reloaded after the assets it uses.
+	static void ReloadAssets(const std::vector<size_t>& changedIndices)
+	{
+		std::vector<bool> visited(assets.size(), false);
+		std::vector<size_t> order;
+		for (size_t index : changedIndices)
+		{
+			if (assets[index].loaded && !assets[index].source.empty())
+				VisitDependents(index, visited, order);
+		}
+		
+		for (auto it = order.rbegin(); it != order.rend(); ++it)
 		{
-			if (asset.source.empty())
+			Asset& asset = assets[*it];
+			if (!asset.loaded)
 				continue;
 			
-			struct stat attrib;
-			stat(asset.source.c_str(), &attrib);
-			auto lastWriteTime = std::chrono::system_clock::from_time_t(attrib.st_mtime);
-			
-			if (lastWriteTime > asset.loadTime)
-			{
-				asset.Unload();
-				LoadAsset(asset);
-				std::cout << "Reloaded asset '" << asset.name << "'.\n";
-			}
+			asset.Unload();
+			LoadAsset(asset);
+			std::cout << "Reloaded asset '" << asset.name << "'.\n";
+		}
+	}
+	
+	void detail::PollChangedAssets()
+	{
+#ifdef __linux__
+		if (!watchStarted)
+			StartWatchingAssets();
+		
+		std::vector<size_t> changed;
+		if (!watchThread.joinable() || changedAssetsOverflowed.exchange(false, std::memory_order_relaxed))
+		{
+			size_t index;
+			while (changedAssets.Pop(index)) { }
+			FindChangedAssetsByTime(changed);
+		}
+		else
+		{
+			size_t index;
+			while (changedAssets.Pop(index))
+				changed.push_back(index);
 		}
+		
+		if (!changed.empty())
+			ReloadAssets(changed);
 #endif
 	}
 	
@@ -2,9 +2,11 @@
 
 #include "Graphics/Texture.hpp"
 #include "API.hpp"
+#include "Utils.hpp"
 
 #include <any>
 #include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <typeindex>
@@ -12,14 +14,92 @@
 
 namespace jm
 {
+	/***
+	 * Identifies an asset by the HashFNV1a64 of its name. The name must be canonical, without "." or ".." parts
+	 * and repeated slashes, which makes it possible to hash string literals at compile time:
+	 *   static constexpr AssetID PLAYER_SPRITE("Sprites/Player.png");
+	 */
+	struct AssetID
+	{
+		uint64_t hash = 0;
+		
+		constexpr AssetID() = default;
+		
+		constexpr explicit AssetID(std::string_view name) noexcept
+			: hash(HashFNV1a64(name)) { }
+		
+		constexpr bool operator==(const AssetID& other) const noexcept
+		{ return hash == other.hash; }
+		constexpr bool operator!=(const AssetID& other) const noexcept
+		{ return hash != other.hash; }
+	};
+	
+	/***
+	 * Memory used by a loaded asset, as reported by its loader.
+	 */
+	struct AssetMemoryUsage
+	{
+		size_t cpuBytes = 0;
+		
+		//Textures and buffers in graphics memory
+		size_t gpuBytes = 0;
+		
+		//Audio buffers owned by OpenAL
+		size_t audioBytes = 0;
+		
+		size_t Total() const
+		{
+			return cpuBytes + gpuBytes + audioBytes;
+		}
+		
+		AssetMemoryUsage& operator+=(const AssetMemoryUsage& other)
+		{
+			cpuBytes += other.cpuBytes;
+			gpuBytes += other.gpuBytes;
+			audioBytes += other.audioBytes;
+			return *this;
+		}
+	};
+	
 	namespace detail
 	{
-		using ProcessAssetCB = void (*)(std::string name, std::string source, std::function<std::vector<char>()> loadCallback);
+		/***
+		 * Data read for an asset. The data is either in a buffer or memory mapped from the file, which is kept
+		 * alive by owner.
+		 */
+		struct AssetData
+		{
+			gsl::span<const char> data;
+			std::shared_ptr<const void> owner;
+			
+			static AssetData FromBuffer(std::vector<char> buffer)
+			{
+				auto ownedBuffer = std::make_shared<const std::vector<char>>(std::move(buffer));
+				return AssetData { gsl::span<const char>(ownedBuffer->data(), ownedBuffer->size()), ownedBuffer };
+			}
+		};
+		
+		using ProcessAssetCB = void (*)(std::string name, std::string source, std::function<AssetData()> loadCallback);
 		
 		struct AssetLoader
 		{
 			std::string extension;
+			
+			//The loader is only used for assets with names starting with this, so that some files with an extension
+			// can be loaded differently. Loaders registered later are preferred if several match.
+			std::string namePrefix;
+			
+			//Loads the asset on the main thread. Used if decodeCallback is not set.
 			std::function<void(gsl::span<const char> data, const std::string& name, void* asset)> loadCallback;
+			
+			//Loaders can instead be split into decoding the data, which runs on a worker thread,
+			// and creating the asset from the decoded data on the main thread.
+			std::function<std::any(gsl::span<const char> data, const std::string& name)> decodeCallback;
+			std::function<void(std::any& decoded, const std::string& name, void* asset)> createCallback;
+			
+			//Measures the memory used by a loaded asset. Assets are counted as sizeof(T) bytes of CPU memory if not set.
+			std::function<AssetMemoryUsage(const void* asset)> memoryUsageCallback;
+			
 			void(*destructor)(void*);
 			std::type_index typeIndex;
 			size_t typeSize;
@@ -30,15 +110,54 @@ namespace jm
 		
 		JAPI extern std::vector<AssetLoader> assetLoaders;
 		
+		/***
+		 * Maps a file into memory so that loaders can read it without copying, or reads it into a buffer
+		 * of the exact size if it can't be mapped. The data is empty if the file can't be read.
+		 */
+		AssetData MapAssetFile(const std::string& path);
+		
 		bool FindAssetsZip(ProcessAssetCB processAsset);
+		bool FindAssetsPack(ProcessAssetCB processAsset);
 		bool FindAssetsDir(ProcessAssetCB processAsset);
 		
+		/***
+		 * Finds all assets and starts loading them on worker threads.
+		 */
 		void LoadAssets();
 		
+		/***
+		 * Creates assets that have finished decoding on worker threads, until timeLimitNS nanoseconds have passed.
+		 */
+		void UpdateAssetLoading(int64_t timeLimitNS);
+		
+		/***
+		 * Stops the loading threads and the thread watching asset files for changes.
+		 */
+		void StopAssetLoading();
+		
 		JAPI void* GetAsset(std::string_view name, std::type_index type);
 		
+		/***
+		 * Finds the index of an asset for use with GetAssetByIndex, panics if the asset doesn't exist
+		 * or is of a different type.
+		 */
+		JAPI size_t FindAssetIndex(std::string_view name, std::type_index type);
+		JAPI size_t FindAssetIndex(AssetID id, std::type_index type);
+		
+		JAPI void* GetAsset(AssetID id, std::type_index type);
+		
+		//Gets an asset for an AssetRef. Unlike GetAsset, this doesn't stop the asset from being evicted.
+		JAPI void* GetAssetByIndex(size_t index);
+		
+		JAPI void AcquireAssetRef(size_t index);
+		JAPI void ReleaseAssetRef(size_t index);
+		
 		JAPI void InitAssetCallback(std::string_view name, std::type_index type, std::function<void(void*)> callback);
 		
+		/***
+		 * Reloads assets whose files have changed, along with the assets that got them while being created.
+		 * Files are watched with inotify from the first call, so only changed assets are checked.
+		 */
 		JAPI void PollChangedAssets();
 	}
 	
@@ -53,12 +172,141 @@ namespace jm
 		assetLoader.destructor = [] (void* asset) { static_cast<T*>(asset)->~T(); };
 	}
 	
+	/***
+	 * Registers a loader that decodes assets on a worker thread, and then creates them from the decoded data
+	 * on the main thread. The decoder must not use GetAsset or the graphics and audio APIs.
+	 */
+	template <typename T, typename DecodedTp>
+	inline void RegisterAssetLoader(std::string extension,
+		std::function<DecodedTp(gsl::span<const char>, const std::string&)> decoder,
+		std::function<T(DecodedTp&, const std::string&)> creator)
+	{
+		auto& assetLoader = detail::assetLoaders.emplace_back(std::move(extension), std::type_index(typeid(T)), sizeof(T));
+		assetLoader.decodeCallback = [decoder=std::move(decoder)] (gsl::span<const char> data, const std::string& name)
+		{
+			return std::any(decoder(data, name));
+		};
+		assetLoader.createCallback = [creator=std::move(creator)] (std::any& decoded, const std::string& name, void* asset)
+		{
+			new (asset) T(creator(*std::any_cast<DecodedTp>(&decoded), name));
+		};
+		assetLoader.destructor = [] (void* asset) { static_cast<T*>(asset)->~T(); };
+	}
+	
+	/***
+	 * Gets an asset, loading it first if it hasn't been loaded yet. Waits for the asset if it is being loaded
+	 * on a worker thread.
+	 */
 	template <typename T>
 	T& GetAsset(std::string_view name)
 	{
 		return *static_cast<T*>(detail::GetAsset(name, std::type_index(typeid(T))));
 	}
 	
+	template <typename T>
+	T& GetAsset(AssetID id)
+	{
+		return *static_cast<T*>(detail::GetAsset(id, std::type_index(typeid(T))));
+	}
+	
+	/***
+	 * Reference to an asset which is looked up once when the reference is created, so that using it
+	 * doesn't have to find the asset by name again. The asset is loaded when it is first used.
+	 * Assets that are only used through AssetRef can be evicted to stay within the memory budget once no references
+	 * to them remain, so references returned by Get must not be kept longer than the AssetRef.
+	 */
+	template <typename T>
+	class AssetRef
+	{
+	public:
+		static constexpr size_t NULL_INDEX = SIZE_MAX;
+		
+		AssetRef() = default;
+		
+		explicit AssetRef(std::string_view name)
+			: m_index(detail::FindAssetIndex(name, std::type_index(typeid(T))))
+		{
+			detail::AcquireAssetRef(m_index);
+		}
+		
+		explicit AssetRef(AssetID id)
+			: m_index(detail::FindAssetIndex(id, std::type_index(typeid(T))))
+		{
+			detail::AcquireAssetRef(m_index);
+		}
+		
+		AssetRef(const AssetRef& other)
+			: m_index(other.m_index)
+		{
+			if (m_index != NULL_INDEX)
+				detail::AcquireAssetRef(m_index);
+		}
+		
+		AssetRef(AssetRef&& other) noexcept
+			: m_index(other.m_index)
+		{
+			other.m_index = NULL_INDEX;
+		}
+		
+		AssetRef& operator=(AssetRef other) noexcept
+		{
+			std::swap(m_index, other.m_index);
+			return *this;
+		}
+		
+		~AssetRef()
+		{
+			if (m_index != NULL_INDEX)
+				detail::ReleaseAssetRef(m_index);
+		}
+		
+		bool IsNull() const
+		{
+			return m_index == NULL_INDEX;
+		}
+		
+		T& Get() const
+		{
+			return *static_cast<T*>(detail::GetAssetByIndex(m_index));
+		}
+		
+		T& operator*() const
+		{
+			return Get();
+		}
+		
+		T* operator->() const
+		{
+			return &Get();
+		}
+		
+	private:
+		size_t m_index = NULL_INDEX;
+	};
+	
+	/***
+	 * Sets how the memory used by assets of a type is measured, for types that own memory outside of the object.
+	 * Must be called after the loaders for the type have been registered.
+	 */
+	template <typename T>
+	inline void SetAssetMemoryUsageCallback(std::function<AssetMemoryUsage(const T&)> callback)
+	{
+		for (detail::AssetLoader& loader : detail::assetLoaders)
+		{
+			if (loader.typeIndex == std::type_index(typeid(T)))
+			{
+				loader.memoryUsageCallback = [callback] (const void* asset)
+				{
+					return callback(*static_cast<const T*>(asset));
+				};
+			}
+		}
+	}
+	
+	/***
+	 * Calls callback with the asset whenever it is created, which is right away if the asset is already loaded,
+	 * and again when it finishes loading, is reloaded or is loaded again after being unloaded.
+	 */
 	template <typename T>
 	void InitAssetCallback(std::string_view name, std::function<void(T& asset)> callback)
 	{
@@ -69,4 +317,79 @@ namespace jm
 	}
 	
 	void DisableAssetReload(std::string_view assetName);
+	
+	struct AssetLoadProgress
+	{
+		size_t numLoaded;
+		size_t numAssets;
+		
+		float Fraction() const
+		{
+			return numAssets == 0 ? 1.0f : (float)numLoaded / (float)numAssets;
+		}
+	};
+	
+	/***
+	 * Gets the number of assets that have been loaded, for example to show progress on a loading screen.
+	 * Assets keep loading in the background between frames.
+	 */
+	JAPI AssetLoadProgress GetAssetLoadProgress();
+	
+	/***
+	 * Finishes loading all assets that are queued for loading.
+	 */
+	JAPI void WaitForAssets();
+	
+	enum class AssetLoadMode
+	{
+		//All assets are queued for loading at startup.
+		Eager,
+		
+		//Assets are only indexed at startup, and loaded by GetAsset or PreloadAssets.
+		Lazy
+	};
+	
+	/***
+	 * Sets whether all assets are loaded at startup. Must be called before Init.
+	 */
+	JAPI void SetAssetLoadMode(AssetLoadMode mode);
+	
+	/***
+	 * Queues all assets whose names start with a prefix for loading on the loading threads,
+	 * for example all assets in a level's directory.
+	 */
+	JAPI void PreloadAssets(std::string_view prefix);
+	
+	/***
+	 * Unloads all assets whose names start with a prefix. They are loaded again if they are used.
+	 * Assets that keep references to other assets, like tile maps to their tile sets, must be unloaded
+	 * together with the assets they reference.
+	 */
+	JAPI void UnloadAssets(std::string_view prefix);
+	
+	struct AssetTypeMemoryUsage
+	{
+		std::type_index type;
+		size_t numLoaded;
+		AssetMemoryUsage usage;
+	};
+	
+	/***
+	 * Gets the memory used by loaded assets, summed per asset type.
+	 */
+	JAPI std::vector<AssetTypeMemoryUsage> GetAssetMemoryUsage();
+	
+	/***
+	 * Gets the total memory used by loaded assets.
+	 */
+	JAPI AssetMemoryUsage GetTotalAssetMemoryUsage();
+	
+	/***
+	 * Sets the number of bytes that loaded assets should fit within, or 0 for no limit.
+	 * While over the budget, assets that are only used through AssetRef and have no references left
+	 * are unloaded once per frame, least recently used first. They are loaded again when they are next used.
+	 * Assets that have been returned by GetAsset are never evicted, since references to them may be kept anywhere,
+	 * until they are unloaded with UnloadAssets.
+	 */
+	JAPI void SetAssetMemoryBudget(size_t bytes);
 }
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+namespace jm::detail
+{
+	/***
+	 * Layout of asset pack files, written by the assetpacker tool and read by FindAssetsPack.
+	 * A pack starts with a PackHeader followed by the entries sorted by the HashFNV1a64 of their names,
+	 * then the names and then the data of each entry. Entry data is aligned to PACK_ALIGNMENT bytes so that stored
+	 * entries can be used in place from a memory mapping. All values are little endian.
+	 */
+	constexpr char PACK_MAGIC[8] = { 'J', 'M', 'P', 'A', 'C', 'K', '\r', '\n' };
+	constexpr uint32_t PACK_VERSION = 1;
+	constexpr uint64_t PACK_ALIGNMENT = 64;
+	
+	enum class PackCompression : uint32_t
+	{
+		Stored = 0,
+		
+		//Raw deflate stream without a zlib header
+		Deflate = 1
+	};
+	
+	struct PackHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t numEntries;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+	};
+	
+	struct PackEntry
+	{
+		uint64_t nameHash;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+		uint64_t uncompressedSize;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		PackCompression compression;
+		uint32_t reserved;
+	};
+	
+	static_assert(sizeof(PackHeader) == 32);
+	static_assert(sizeof(PackEntry) == 48);
+}
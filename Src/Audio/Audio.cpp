@@ -1,14 +1,211 @@
 #include "Audio.hpp"
+#include "AudioCommand.hpp"
+#include "../SPSCQueue.hpp"
 #include "Utils.hpp"
 
 #include <AL/al.h>
 #include <AL/alc.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace jm
 {
 	ALCdevice* alDevice;
 	ALCcontext* alContext;
 	
+	//Enough for a few thousand source changes per frame. If the queue fills up, the audio thread is woken to make room.
+	static constexpr size_t AUDIO_COMMAND_QUEUE_CAPACITY = 4096;
+	
+	//How often the audio thread updates streams and finds stopped sources when it isn't woken by FlushAudioCommands
+	static constexpr std::chrono::milliseconds AUDIO_UPDATE_INTERVAL(10);
+	
+	static SPSCQueue<detail::AudioCommand> audioCommands(AUDIO_COMMAND_QUEUE_CAPACITY);
+	static uint64_t numSubmittedAudioCommands = 0;
+	static std::atomic<uint64_t> numAppliedAudioCommands { 0 };
+	
+	//Sources that have been added, only used by the thread applying commands
+	static std::vector<detail::AudioSourceState*> audioSources;
+	
+	static std::thread audioThread;
+	static std::mutex audioThreadMutex;
+	static std::condition_variable audioThreadSignal;
+	static bool audioFlushRequested = false;
+	static bool stopAudioThread = false;
+	
+	//Set by CloseOpenAL, after which commands are ignored since there is no context to apply them to
+	static bool audioClosed = false;
+	
+	void detail::DeleteAudioSource(AudioSourceState* source)
+	{
+		alDeleteSources(1, &source->handle);
+		audioSources.erase(std::find(audioSources.begin(), audioSources.end(), source));
+		delete source;
+	}
+	
+	static void ApplyAudioCommand(detail::AudioCommand& command)
+	{
+		using detail::AudioCommandType;
+		
+		const ALuint source = command.source != nullptr ? command.source->handle : 0;
+		const glm::vec3& vector = command.vector;
+		
+		switch (command.type)
+		{
+		case AudioCommandType::AddSource:
+			audioSources.push_back(command.source);
+			break;
+		case AudioCommandType::DeleteSource:
+			detail::DeleteAudioSource(command.source);
+			break;
+		case AudioCommandType::DeleteBuffer:
+			alDeleteBuffers(1, &command.intValue);
+			break;
+		case AudioCommandType::SetPosition:
+			alSource3f(source, AL_POSITION, vector.x, vector.y, vector.z);
+			break;
+		case AudioCommandType::SetVelocity:
+			alSource3f(source, AL_VELOCITY, vector.x, vector.y, vector.z);
+			break;
+		case AudioCommandType::SetDirection:
+			alSource3f(source, AL_DIRECTION, vector.x, vector.y, vector.z);
+			break;
+		case AudioCommandType::SetAttenuation:
+			alSourcef(source, AL_ROLLOFF_FACTOR, command.values[0]);
+			alSourcef(source, AL_REFERENCE_DISTANCE, command.values[1]);
+			break;
+		case AudioCommandType::SetVolume:
+			alSourcef(source, AL_GAIN, command.values[0]);
+			break;
+		case AudioCommandType::SetPitch:
+			alSourcef(source, AL_PITCH, command.values[0]);
+			break;
+		case AudioCommandType::SetBuffer:
+			alSourcei(source, AL_BUFFER, command.intValue);
+			break;
+		case AudioCommandType::SetLooping:
+			alSourcei(source, AL_LOOPING, command.intValue ? AL_TRUE : AL_FALSE);
+			break;
+		case AudioCommandType::SetRelative:
+			alSourcei(source, AL_SOURCE_RELATIVE, command.intValue ? AL_TRUE : AL_FALSE);
+			break;
+		case AudioCommandType::Play:
+			alSourcePlay(source);
+			command.source->isPlaying.store(true, std::memory_order_relaxed);
+			break;
+		case AudioCommandType::Stop:
+			alSourceStop(source);
+			command.source->isPlaying.store(false, std::memory_order_relaxed);
+			break;
+		case AudioCommandType::SetListenerPosition:
+			alListener3f(AL_POSITION, vector.x, vector.y, vector.z);
+			break;
+		case AudioCommandType::SetListenerVelocity:
+			alListener3f(AL_VELOCITY, vector.x, vector.y, vector.z);
+			break;
+		case AudioCommandType::SetMasterVolume:
+			alListenerf(AL_GAIN, command.values[0]);
+			break;
+		default:
+			detail::ApplyStreamCommand(command);
+			break;
+		}
+	}
+	
+	static void ApplyAudioCommands()
+	{
+		detail::AudioCommand command;
+		while (audioCommands.Pop(command))
+		{
+			ApplyAudioCommand(command);
+			numAppliedAudioCommands.fetch_add(1, std::memory_order_release);
+		}
+	}
+	
+	//Finds sources that have stopped by themselves since they were played.
+	static void UpdateSourceStates()
+	{
+		for (detail::AudioSourceState* source : audioSources)
+		{
+			if (!source->isPlaying.load(std::memory_order_relaxed))
+				continue;
+			
+			ALint state;
+			alGetSourcei(source->handle, AL_SOURCE_STATE, &state);
+			if (state != AL_PLAYING)
+				source->isPlaying.store(false, std::memory_order_relaxed);
+		}
+	}
+	
+	static void AudioThreadMain()
+	{
+		std::unique_lock<std::mutex> lock(audioThreadMutex);
+		while (true)
+		{
+			audioThreadSignal.wait_for(lock, AUDIO_UPDATE_INTERVAL, [] { return audioFlushRequested || stopAudioThread; });
+			audioFlushRequested = false;
+			const bool stop = stopAudioThread;
+			lock.unlock();
+			
+			ApplyAudioCommands();
+			detail::UpdateAudioStreams();
+			UpdateSourceStates();
+			
+			if (stop)
+				return;
+			lock.lock();
+		}
+	}
+	
+	uint64_t detail::SubmitAudioCommand(AudioCommand command)
+	{
+		numSubmittedAudioCommands++;
+		
+		if (audioClosed)
+		{
+			numAppliedAudioCommands.store(numSubmittedAudioCommands, std::memory_order_release);
+			return numSubmittedAudioCommands;
+		}
+		
+		if (!audioThread.joinable())
+		{
+			ApplyAudioCommand(command);
+			numAppliedAudioCommands.store(numSubmittedAudioCommands, std::memory_order_release);
+			return numSubmittedAudioCommands;
+		}
+		
+		while (!audioCommands.Push(command))
+		{
+			FlushAudioCommands();
+			std::this_thread::yield();
+		}
+		return numSubmittedAudioCommands;
+	}
+	
+	bool detail::AudioCommandsApplied(uint64_t numCommands)
+	{
+		return numAppliedAudioCommands.load(std::memory_order_acquire) >= numCommands;
+	}
+	
+	void detail::FlushAudioCommands()
+	{
+		//Without an audio thread, commands are applied as they are submitted and the rest is updated once per frame
+		if (!audioThread.joinable())
+		{
+			UpdateAudioStreams();
+			UpdateSourceStates();
+			return;
+		}
+		
+		{
+			std::lock_guard<std::mutex> lock(audioThreadMutex);
+			audioFlushRequested = true;
+		}
+		audioThreadSignal.notify_one();
+	}
+	
 	void detail::InitializeOpenAL()
 	{
 		alDevice = alcOpenDevice(nullptr);
@@ -19,32 +216,74 @@ namespace jm
 		if (alContext == nullptr)
 			Panic("Error creating OpenAL context.");
 		alcMakeContextCurrent(alContext);
+		
+#ifndef __EMSCRIPTEN__
+		audioThread = std::thread(&AudioThreadMain);
+#endif
 	}
 	
 	void detail::CloseOpenAL()
 	{
+		//The audio thread applies the remaining commands before it exits
+		if (audioThread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(audioThreadMutex);
+				stopAudioThread = true;
+			}
+			audioThreadSignal.notify_one();
+			audioThread.join();
+		}
+		
+		audioClosed = true;
 		alcDestroyContext(alContext);
 		alcCloseDevice(alDevice);
 	}
 	
+	static detail::AudioCommand MakeAudioCommand(detail::AudioCommandType type, detail::AudioSourceState* source = nullptr)
+	{
+		detail::AudioCommand command;
+		command.type = type;
+		command.source = source;
+		return command;
+	}
+	
 	void UpdateListener(const glm::vec3& position, const glm::vec3& velocity)
 	{
-		alListener3f(AL_POSITION, position.x, position.y, position.z);
-		alListener3f(AL_VELOCITY, velocity.x, velocity.y, velocity.z);
+		detail::AudioCommand positionCommand = MakeAudioCommand(detail::AudioCommandType::SetListenerPosition);
+		positionCommand.vector = position;
+		detail::SubmitAudioCommand(positionCommand);
+		
+		detail::AudioCommand velocityCommand = MakeAudioCommand(detail::AudioCommandType::SetListenerVelocity);
+		velocityCommand.vector = velocity;
+		detail::SubmitAudioCommand(velocityCommand);
 	}
 	
 	void SetMasterVolume(float volume)
 	{
-		alListenerf(AL_GAIN, volume);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetMasterVolume);
+		command.values[0] = volume;
+		detail::SubmitAudioCommand(command);
+	}
+	
+	//Buffers are deleted by the audio thread, after the commands that may still use them
+	static void DeleteBuffersLater(int count, const uint32_t* buffers)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::DeleteBuffer);
+			command.intValue = buffers[i];
+			detail::SubmitAudioCommand(command);
+		}
 	}
 	
 	AudioClip::AudioClip()
 	{
-		m_handle.deleter = &alDeleteBuffers;
+		m_handle.deleter = &DeleteBuffersLater;
 		alGenBuffers(1, &m_handle.handle);
 	}
 	
-	static const ALenum FORMAT_TRANSLATION[] = 
+	static const ALenum FORMAT_TRANSLATION[] =
 	{
 		AL_FORMAT_MONO8, AL_FORMAT_MONO16, AL_FORMAT_STEREO8, AL_FORMAT_STEREO16
 	};
@@ -52,74 +291,124 @@ namespace jm
 	void AudioClip::SetData(AudioFormat format, size_t dataBytes, const void* data, int frequency)
 	{
 		alBufferData(m_handle.handle, FORMAT_TRANSLATION[(int)format], data, dataBytes, frequency);
+		m_dataBytes = dataBytes;
 	}
 	
 	AudioSource::AudioSource()
+		: m_state(new detail::AudioSourceState())
+	{
+		alGenSources(1, &m_state->handle);
+		detail::SubmitAudioCommand(MakeAudioCommand(detail::AudioCommandType::AddSource, m_state));
+	}
+	
+	AudioSource::~AudioSource()
+	{
+		if (m_state != nullptr)
+			detail::SubmitAudioCommand(MakeAudioCommand(detail::AudioCommandType::DeleteSource, m_state));
+	}
+	
+	AudioSource::AudioSource(AudioSource&& other) noexcept
+		: m_state(other.m_state), m_playStopCommandsEnd(other.m_playStopCommandsEnd),
+		  m_playStopIsPlay(other.m_playStopIsPlay)
+	{
+		other.m_state = nullptr;
+	}
+	
+	AudioSource& AudioSource::operator=(AudioSource&& other) noexcept
 	{
-		m_handle.deleter = &alDeleteSources;
-		alGenSources(1, &m_handle.handle);
+		if (this != &other)
+		{
+			if (m_state != nullptr)
+				detail::SubmitAudioCommand(MakeAudioCommand(detail::AudioCommandType::DeleteSource, m_state));
+			
+			m_state = other.m_state;
+			m_playStopCommandsEnd = other.m_playStopCommandsEnd;
+			m_playStopIsPlay = other.m_playStopIsPlay;
+			other.m_state = nullptr;
+		}
+		return *this;
 	}
 	
 	void AudioSource::SetPosition(glm::vec3 position)
 	{
-		alSource3f(m_handle.handle, AL_POSITION, position.x, position.y, position.z);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetPosition, m_state);
+		command.vector = position;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetVelocity(glm::vec3 velocity)
 	{
-		alSource3f(m_handle.handle, AL_VELOCITY, velocity.x, velocity.y, velocity.z);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetVelocity, m_state);
+		command.vector = velocity;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetDirection(glm::vec3 direction)
 	{
-		alSource3f(m_handle.handle, AL_DIRECTION, direction.x, direction.y, direction.z);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetDirection, m_state);
+		command.vector = direction;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetAttenuation(float rolloffFactor, float refDistance)
 	{
-		alSourcef(m_handle.handle, AL_ROLLOFF_FACTOR, rolloffFactor);
-		alSourcef(m_handle.handle, AL_REFERENCE_DISTANCE, refDistance);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetAttenuation, m_state);
+		command.values[0] = rolloffFactor;
+		command.values[1] = refDistance;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetVolume(float volume)
 	{
-		alSourcef(m_handle.handle, AL_GAIN, volume);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetVolume, m_state);
+		command.values[0] = volume;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetPitch(float pitch)
 	{
-		alSourcef(m_handle.handle, AL_PITCH, pitch);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetPitch, m_state);
+		command.values[0] = pitch;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetClip(const AudioClip& clip)
 	{
-		alSourcei(m_handle.handle, AL_BUFFER, clip.m_handle.handle);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetBuffer, m_state);
+		command.intValue = clip.m_handle.handle;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetIsLooping(bool isLooping)
 	{
-		alSourcei(m_handle.handle, AL_LOOPING, isLooping ? AL_TRUE : AL_FALSE);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetLooping, m_state);
+		command.intValue = isLooping;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::SetTransformRelative(bool relativeTransform)
 	{
-		alSourcei(m_handle.handle, AL_SOURCE_RELATIVE, relativeTransform ? AL_TRUE : AL_FALSE);
+		detail::AudioCommand command = MakeAudioCommand(detail::AudioCommandType::SetRelative, m_state);
+		command.intValue = relativeTransform;
+		detail::SubmitAudioCommand(command);
 	}
 	
 	void AudioSource::Play()
 	{
-		alSourcePlay(m_handle.handle);
+		m_playStopCommandsEnd = detail::SubmitAudioCommand(MakeAudioCommand(detail::AudioCommandType::Play, m_state));
+		m_playStopIsPlay = true;
 	}
 	
 	void AudioSource::Stop()
 	{
-		alSourceStop(m_handle.handle);
+		m_playStopCommandsEnd = detail::SubmitAudioCommand(MakeAudioCommand(detail::AudioCommandType::Stop, m_state));
+		m_playStopIsPlay = false;
 	}
 	
 	bool AudioSource::IsPlaying() const
 	{
-		ALint state;
-		alGetSourcei(m_handle.handle, AL_SOURCE_STATE, &state);
-		return state == AL_PLAYING;
+		if (!detail::AudioCommandsApplied(m_playStopCommandsEnd))
+			return m_playStopIsPlay;
+		return m_state->isPlaying.load(std::memory_order_acquire);
 	}
 }
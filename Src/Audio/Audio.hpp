@@ -3,14 +3,27 @@
 #include "../API.hpp"
 
 #include <glm/glm.hpp>
+#include <cstdint>
 
 namespace jm
 {
 	namespace detail
 	{
+		/***
+		 * Opens the audio device and starts the audio thread, which applies the commands recorded by AudioSource
+		 * and the other audio functions, and updates streams.
+		 */
 		void InitializeOpenAL();
 		void CloseOpenAL();
 		
+		/***
+		 * Wakes the audio thread to apply the commands recorded during the frame. Called once per frame.
+		 */
+		void FlushAudioCommands();
+		
+		struct AudioStream;
+		struct AudioSourceState;
+		
 		struct ALHandle
 		{
 			ALHandle()
@@ -44,6 +57,14 @@ namespace jm
 	JAPI void UpdateListener(const glm::vec3& position, const glm::vec3& velocity = glm::vec3(0.0f));
 	JAPI void SetMasterVolume(float volume);
 	
+	/***
+	 * Caches decoded Ogg Vorbis audio clips in the SDL pref path for org and app, so that they don't have to be
+	 * decoded again on the next launch. Clips are found in the cache by a hash of the file, so changed files are decoded
+	 * again. Must be called before Init.
+	 * @param maxBytes If the cache is larger than this at startup, the least recently used clips are removed from it.
+	 */
+	JAPI void EnableDecodedAudioCache(const char* org, const char* app, size_t maxBytes = 256 * 1024 * 1024);
+	
 	inline void UpdateListener(const glm::vec2& position, const glm::vec2& velocity = glm::vec2(0.0f))
 	{
 		UpdateListener(glm::vec3(position, 0), glm::vec3(velocity, 0));
@@ -66,16 +87,33 @@ namespace jm
 		
 		void SetData(AudioFormat format, size_t dataBytes, const void* data, int frequency);
 		
+		size_t DataBytes() const
+		{
+			return m_dataBytes;
+		}
+		
 	private:
 		detail::ALHandle m_handle;
+		size_t m_dataBytes = 0;
 	};
 	
+	/***
+	 * A source that plays audio clips. Changes to the source are recorded and applied on the audio thread,
+	 * so they don't call into OpenAL on the calling thread.
+	 */
 	class JAPI AudioSource
 	{
 	public:
+		friend struct detail::AudioStream;
+		
 		AudioSource();
+		~AudioSource();
+		
+		AudioSource(AudioSource&& other) noexcept;
+		AudioSource& operator=(AudioSource&& other) noexcept;
 		
 		explicit AudioSource(const AudioClip& clip)
+			: AudioSource()
 		{
 			SetClip(clip);
 		}
@@ -106,6 +144,11 @@ namespace jm
 		void SetPitch(float pitch);
 		
 	private:
-		detail::ALHandle m_handle;
+		detail::AudioSourceState* m_state;
+		
+		//The number of commands submitted up to the last Play or Stop, and whether that was Play. Used by IsPlaying
+		// until the audio thread has applied the command.
+		uint64_t m_playStopCommandsEnd = 0;
+		bool m_playStopIsPlay = false;
 	};
 }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Audio.hpp"
+#include "StreamingAudio.hpp"
+
+#include <atomic>
+
+namespace jm::detail
+{
+	//State of a source shared with the audio thread. It is deleted by the audio thread after the source.
+	struct AudioSourceState
+	{
+		uint32_t handle = 0;
+		
+		//Set by the audio thread when it starts the source, and cleared when it finds that the source has stopped
+		std::atomic<bool> isPlaying { false };
+	};
+	
+	enum class AudioCommandType
+	{
+		AddSource,
+		DeleteSource,
+		DeleteBuffer,
+		SetPosition,
+		SetVelocity,
+		SetDirection,
+		SetAttenuation,
+		SetVolume,
+		SetPitch,
+		SetBuffer,
+		SetLooping,
+		SetRelative,
+		Play,
+		Stop,
+		SetListenerPosition,
+		SetListenerVelocity,
+		SetMasterVolume,
+		AddStream,
+		DeleteStream,
+		SetStreamClip,
+		SetStreamLooping,
+		PlayStream,
+		StopStream
+	};
+	
+	struct AudioCommand
+	{
+		AudioCommandType type;
+		
+		AudioSourceState* source = nullptr;
+		AudioStream* stream = nullptr;
+		
+		//Owned by the command, deleted once it has been applied
+		StreamingAudioClip* streamClip = nullptr;
+		
+		glm::vec3 vector;
+		float values[2];
+		
+		//A buffer handle or a boolean
+		uint32_t intValue = 0;
+	};
+	
+	/***
+	 * Queues a command to be applied by the audio thread. Commands are applied in the order they are submitted,
+	 * at the latest after the next call to FlushAudioCommands. Without an audio thread the command is applied immediately.
+	 * Must only be called from the main thread.
+	 * @return The number of commands submitted so far, including this one.
+	 */
+	uint64_t SubmitAudioCommand(AudioCommand command);
+	
+	/***
+	 * Checks whether the first numCommands submitted commands have been applied.
+	 */
+	bool AudioCommandsApplied(uint64_t numCommands);
+	
+	//Used by the thread applying commands, which is the audio thread if there is one.
+	void ApplyStreamCommand(AudioCommand& command);
+	void UpdateAudioStreams();
+	void DeleteAudioSource(AudioSourceState* source);
+}
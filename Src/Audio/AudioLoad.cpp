@@ -1,17 +1,38 @@
 #include "Audio.hpp"
+#include "StreamingAudio.hpp"
 #include "../Utils.hpp"
 #include "../Asset.hpp"
 
 #include <gsl/gsl>
 #include <string>
+#include <memory>
+#include <optional>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <filesystem>
 #include <SDL_audio.h>
+#include <SDL_filesystem.h>
 
 #define STB_VORBIS_NO_STDIO
 #include <stb_vorbis.c>
 
 namespace jm
 {
-	AudioClip LoadWAVAsset(gsl::span<const char> fileData, const std::string& name)
+	//Audio data decoded on a loading thread, uploaded to a clip on the main thread.
+	struct DecodedAudio
+	{
+		AudioFormat format;
+		std::shared_ptr<const uint8_t> data;
+		size_t dataBytes;
+		int frequency;
+	};
+	
+	DecodedAudio DecodeWAV(gsl::span<const char> fileData, const std::string& name)
 	{
 		SDL_AudioSpec audioSpec;
 		uint8_t* audioBuffer;
@@ -25,6 +46,8 @@ namespace jm
 			Panic(Concat({ "Error loading WAV from '", name, "': ", SDL_GetError(), "."}));
 		}
 		
+		std::shared_ptr<const uint8_t> data(audioBuffer, &SDL_FreeWAV);
+		
 		AudioFormat format;
 		if (audioSpec.format == AUDIO_S16SYS)
 		{
@@ -39,15 +62,197 @@ namespace jm
 			Panic(Concat({ "Error loading WAV from '", name, "': the file uses an incompatible format."}));
 		}
 		
-		DisableAssetReload(name);
+		return DecodedAudio { format, std::move(data), audioSpec.size, audioSpec.freq };
+	}
+	
+	static std::string decodedAudioCacheOrg;
+	static std::string decodedAudioCacheApp;
+	static uintmax_t decodedAudioCacheMaxBytes;
+	
+	//Directory of cached decoded audio, empty if the cache isn't enabled. Only written before loading starts.
+	static std::string decodedAudioCachePath;
+	
+	static constexpr char DECODED_AUDIO_MAGIC[4] = { 'J', 'P', 'C', 'M' };
+	static constexpr uint32_t DECODED_AUDIO_VERSION = 1;
+	
+	//Cache files start with this header, followed by the decoded samples
+	struct DecodedAudioHeader
+	{
+		char magic[4];
+		uint32_t version;
+		AudioFormat format;
+		int32_t frequency;
 		
-		AudioClip clip;
-		clip.SetData(format, audioSpec.size, audioBuffer, audioSpec.freq);
-		return clip;
+		//The size of the file that was decoded, compared in addition to the hash in the cache file's name
+		uint64_t fileSize;
+		uint64_t dataBytes;
+	};
+	
+	void EnableDecodedAudioCache(const char* org, const char* app, size_t maxBytes)
+	{
+		decodedAudioCacheOrg = org;
+		decodedAudioCacheApp = app;
+		decodedAudioCacheMaxBytes = maxBytes;
+	}
+	
+#ifndef __EMSCRIPTEN__
+	//Removes temporary files left by writes that were interrupted, and the least recently used files
+	// if the cache is larger than its maximum size.
+	static void CleanDecodedAudioCache()
+	{
+		namespace fs = std::filesystem;
+		
+		struct CacheFile
+		{
+			fs::path path;
+			uintmax_t size;
+			fs::file_time_type lastUsed;
+		};
+		
+		std::vector<CacheFile> files;
+		uintmax_t totalBytes = 0;
+		
+		std::error_code error;
+		for (fs::directory_iterator it(decodedAudioCachePath, error), end; !error && it != end; it.increment(error))
+		{
+			std::error_code fileError;
+			const fs::path& path = it->path();
+			if (path.extension() == ".tmp")
+			{
+				fs::remove(path, fileError);
+			}
+			else if (path.extension() == ".pcm")
+			{
+				CacheFile file { path, it->file_size(fileError), it->last_write_time(fileError) };
+				if (!fileError)
+				{
+					totalBytes += file.size;
+					files.push_back(std::move(file));
+				}
+			}
+		}
+		
+		if (totalBytes <= decodedAudioCacheMaxBytes)
+			return;
+		
+		std::sort(files.begin(), files.end(), [] (const CacheFile& a, const CacheFile& b)
+		{
+			return a.lastUsed < b.lastUsed;
+		});
+		
+		for (const CacheFile& file : files)
+		{
+			if (totalBytes <= decodedAudioCacheMaxBytes)
+				break;
+			
+			std::error_code removeError;
+			if (fs::remove(file.path, removeError))
+				totalBytes -= file.size;
+		}
+	}
+#endif
+	
+	static void InitDecodedAudioCache()
+	{
+#ifndef __EMSCRIPTEN__
+		if (decodedAudioCacheOrg.empty())
+			return;
+		
+		char* prefPath = SDL_GetPrefPath(decodedAudioCacheOrg.c_str(), decodedAudioCacheApp.c_str());
+		if (prefPath == nullptr)
+			return;
+		std::string path = Concat({ prefPath, "AudioCache/" });
+		SDL_free(prefPath);
+		
+		std::error_code error;
+		std::filesystem::create_directories(path, error);
+		if (error)
+			return;
+		
+		decodedAudioCachePath = std::move(path);
+		CleanDecodedAudioCache();
+#endif
+	}
+	
+	static std::string DecodedAudioCacheFilePath(uint64_t fileHash)
+	{
+		char name[24];
+		std::snprintf(name, sizeof(name), "%016llx.pcm", (unsigned long long)fileHash);
+		return decodedAudioCachePath + name;
 	}
 	
-	AudioClip LoadVorbisAsset(gsl::span<const char> fileData, const std::string& name)
+	static std::optional<DecodedAudio> ReadDecodedAudioCache(uint64_t fileHash, size_t fileSize)
 	{
+		const std::string path = DecodedAudioCacheFilePath(fileHash);
+		detail::AssetData cached = detail::MapAssetFile(path);
+		if ((size_t)cached.data.size() < sizeof(DecodedAudioHeader))
+			return { };
+		
+		//The header is checked fully, since a corrupt format would be used to index tables when the clip is created
+		DecodedAudioHeader header;
+		std::memcpy(&header, cached.data.data(), sizeof(DecodedAudioHeader));
+		if (std::memcmp(header.magic, DECODED_AUDIO_MAGIC, sizeof(DECODED_AUDIO_MAGIC)) != 0 ||
+		    header.version != DECODED_AUDIO_VERSION || header.fileSize != fileSize ||
+		    header.dataBytes != cached.data.size() - sizeof(DecodedAudioHeader) ||
+		    (int)header.format < (int)AudioFormat::Mono8 || (int)header.format > (int)AudioFormat::Stereo16 ||
+		    header.frequency <= 0)
+		{
+			return { };
+		}
+		
+#ifndef __EMSCRIPTEN__
+		//Files are removed in order of their modification time when the cache is too large, so it is updated on use
+		std::error_code error;
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+#endif
+		
+		//The samples are used in place from the mapped file
+		const auto* samples = reinterpret_cast<const uint8_t*>(cached.data.data() + sizeof(DecodedAudioHeader));
+		std::shared_ptr<const uint8_t> data(cached.owner, samples);
+		return DecodedAudio { header.format, std::move(data), header.dataBytes, header.frequency };
+	}
+	
+	static void WriteDecodedAudioCache(uint64_t fileHash, size_t fileSize, const DecodedAudio& decoded)
+	{
+		DecodedAudioHeader header = { };
+		std::memcpy(header.magic, DECODED_AUDIO_MAGIC, sizeof(DECODED_AUDIO_MAGIC));
+		header.version = DECODED_AUDIO_VERSION;
+		header.format = decoded.format;
+		header.frequency = decoded.frequency;
+		header.fileSize = fileSize;
+		header.dataBytes = decoded.dataBytes;
+		
+		//Written to a temporary file first, so that a partially written file is never read
+		static std::atomic<uint32_t> nextTempFileIndex { 0 };
+		const std::string path = DecodedAudioCacheFilePath(fileHash);
+		const std::string tempPath = path + "." + std::to_string(nextTempFileIndex++) + ".tmp";
+		
+		{
+			std::ofstream stream(tempPath, std::ios::binary);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(DecodedAudioHeader));
+			stream.write(reinterpret_cast<const char*>(decoded.data.get()), decoded.dataBytes);
+			if (!stream)
+			{
+				stream.close();
+				std::remove(tempPath.c_str());
+				return;
+			}
+		}
+		
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+			std::remove(tempPath.c_str());
+	}
+	
+	DecodedAudio DecodeVorbis(gsl::span<const char> fileData, const std::string& name)
+	{
+		const bool useCache = !decodedAudioCachePath.empty();
+		const uint64_t fileHash = useCache ? HashFNV1a64(std::string_view(fileData.data(), fileData.size())) : 0;
+		if (useCache)
+		{
+			if (std::optional<DecodedAudio> cached = ReadDecodedAudioCache(fileHash, fileData.size()))
+				return std::move(*cached);
+		}
+		
 		int numChannels, sampleRate;
 		short* audioBuffer;
 		
@@ -62,16 +267,61 @@ namespace jm
 		
 		AudioFormat format = numChannels == 1 ? AudioFormat::Mono16 : AudioFormat::Stereo16;
 		
+		std::shared_ptr<const uint8_t> data(reinterpret_cast<uint8_t*>(audioBuffer), &std::free);
+		DecodedAudio decoded { format, std::move(data), (size_t)numSamples * numChannels * 2, sampleRate };
+		
+		if (useCache)
+			WriteDecodedAudioCache(fileHash, fileData.size(), decoded);
+		
+		return decoded;
+	}
+	
+	AudioClip CreateAudioClip(DecodedAudio& decoded, const std::string& name)
+	{
 		DisableAssetReload(name);
 		
 		AudioClip clip;
-		clip.SetData(format, numSamples * 2, audioBuffer, sampleRate);
+		clip.SetData(decoded.format, decoded.dataBytes, decoded.data.get(), decoded.frequency);
 		return clip;
 	}
 	
+	//Empty if streaming is not enabled, since every name starts with the empty prefix
+	static std::string streamingAudioPrefix;
+	
+	void SetStreamingAudioPrefix(std::string prefix)
+	{
+		streamingAudioPrefix = std::move(prefix);
+	}
+	
+	StreamingAudioClip DecodeStreamingVorbis(gsl::span<const char> fileData, const std::string& name)
+	{
+		//The asset data is only kept until the asset has been created, so the compressed file is copied
+		auto data = std::make_shared<const std::vector<char>>(fileData.begin(), fileData.end());
+		return StreamingAudioClip(std::move(data), name);
+	}
+	
 	void RegisterAudioAssetLoaders()
 	{
-		RegisterAssetLoader<AudioClip>("wav", &LoadWAVAsset);
-		RegisterAssetLoader<AudioClip>("ogg", &LoadVorbisAsset);
+		InitDecodedAudioCache();
+		
+		RegisterAssetLoader<AudioClip, DecodedAudio>("wav", &DecodeWAV, &CreateAudioClip);
+		RegisterAssetLoader<AudioClip, DecodedAudio>("ogg", &DecodeVorbis, &CreateAudioClip);
+		
+		if (!streamingAudioPrefix.empty())
+		{
+			RegisterAssetLoader<StreamingAudioClip, StreamingAudioClip>("ogg", &DecodeStreamingVorbis,
+				[] (StreamingAudioClip& clip, const std::string&) { return std::move(clip); });
+			detail::assetLoaders.back().namePrefix = streamingAudioPrefix;
+		}
+		
+		SetAssetMemoryUsageCallback<AudioClip>([] (const AudioClip& clip)
+		{
+			return AssetMemoryUsage { sizeof(AudioClip), 0, clip.DataBytes() };
+		});
+		
+		SetAssetMemoryUsageCallback<StreamingAudioClip>([] (const StreamingAudioClip& clip)
+		{
+			return AssetMemoryUsage { sizeof(StreamingAudioClip) + clip.DataBytes(), 0, 0 };
+		});
 	}
 }
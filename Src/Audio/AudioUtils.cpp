@@ -1,53 +1,133 @@
 #include "AudioUtils.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <random>
 
 namespace jm
 {
-	struct SoundEffectSource
+	struct SoundEffectVoice
 	{
 		AudioSource source;
-		const AudioClip* clip;
+		
+		//Null if the voice is free
+		const AudioClip* clip = nullptr;
+		int priority = 0;
+		
+		//Increases with each sound played, so that older sounds have lower values
+		uint64_t playIndex = 0;
 	};
 	
-	static std::vector<SoundEffectSource> soundEffectSources;
+	//Voices are created as they are needed, up to maxSoundEffectVoices. Whether they are still playing is only
+	// checked by UpdateSoundEffectVoices, so playing sounds doesn't have to query every source.
+	static std::vector<SoundEffectVoice> soundEffectVoices;
+	static size_t maxSoundEffectVoices = 32;
+	static uint64_t nextSoundEffectPlayIndex = 0;
 	
-	void PlaySoundEffect(const AudioClip& clip, glm::vec3 position, SoundEffectParams params)
+	void SetMaxSoundEffectVoices(int maxVoices)
+	{
+		maxSoundEffectVoices = (size_t)std::max(maxVoices, 1);
+		if (soundEffectVoices.size() > maxSoundEffectVoices)
+			soundEffectVoices.resize(maxSoundEffectVoices);
+	}
+	
+	void detail::UpdateSoundEffectVoices()
 	{
-		SoundEffectSource* source = nullptr;
+		for (SoundEffectVoice& voice : soundEffectVoices)
+		{
+			if (voice.clip != nullptr && !voice.source.IsPlaying())
+				voice.clip = nullptr;
+		}
+	}
+	
+	//Finds the voice to play a sound on, or returns null if the sound should not play.
+	static SoundEffectVoice* SelectSoundEffectVoice(const AudioClip& clip, const SoundEffectParams& params)
+	{
+		SoundEffectVoice* freeVoice = nullptr;
+		SoundEffectVoice* oldestInstance = nullptr;
+		SoundEffectVoice* stealCandidate = nullptr;
+		int numInstances = 0;
 		
-		for (SoundEffectSource& sourceCan : soundEffectSources)
+		for (SoundEffectVoice& voice : soundEffectVoices)
 		{
-			if (!sourceCan.source.IsPlaying())
+			if (voice.clip == nullptr)
 			{
-				source = &sourceCan;
-				break;
+				if (freeVoice == nullptr)
+					freeVoice = &voice;
+				continue;
+			}
+			
+			if (voice.clip == &clip)
+			{
+				numInstances++;
+				if (oldestInstance == nullptr || voice.playIndex < oldestInstance->playIndex)
+					oldestInstance = &voice;
+			}
+			
+			if (stealCandidate == nullptr || voice.priority < stealCandidate->priority ||
+			    (voice.priority == stealCandidate->priority && voice.playIndex < stealCandidate->playIndex))
+			{
+				stealCandidate = &voice;
 			}
 		}
 		
-		if (source == nullptr)
-		{
-			source = &soundEffectSources.emplace_back();
-		}
+		if (numInstances >= params.maxInstances && oldestInstance != nullptr)
+			return oldestInstance;
+		if (freeVoice != nullptr)
+			return freeVoice;
+		if (soundEffectVoices.size() < maxSoundEffectVoices)
+			return &soundEffectVoices.emplace_back();
+		if (stealCandidate != nullptr && stealCandidate->priority <= params.priority)
+			return stealCandidate;
+		return nullptr;
+	}
+	
+	void PlaySoundEffect(const AudioClip& clip, glm::vec3 position, SoundEffectParams params)
+	{
+		SoundEffectVoice* voice = SelectSoundEffectVoice(clip, params);
+		if (voice == nullptr)
+			return;
 		
-		source->source.SetClip(clip);
-		source->source.SetPosition(position);
-		source->source.SetVolume(params.volume);
-		source->source.SetPitch(params.pitch);
-		source->source.SetAttenuation(params.rolloffFactor, params.refDistance);
-		source->clip = &clip;
+		//The clip of a source can't be changed while it is playing
+		if (voice->clip != nullptr)
+			voice->source.Stop();
 		
-		source->source.Play();
+		voice->source.SetClip(clip);
+		voice->source.SetPosition(position);
+		voice->source.SetVolume(params.volume);
+		voice->source.SetPitch(params.pitch);
+		voice->source.SetAttenuation(params.rolloffFactor, params.refDistance);
+		voice->clip = &clip;
+		voice->priority = params.priority;
+		voice->playIndex = nextSoundEffectPlayIndex++;
+		
+		voice->source.Play();
 	}
 	
 	MusicPlayer::MusicPlayer()
 		: m_rng(std::chrono::high_resolution_clock::now().time_since_epoch().count())
 	{
+		m_streamingSource.Source().SetTransformRelative(true);
 		m_source.SetTransformRelative(true);
 	}
 	
+	void MusicPlayer::SetTracks(std::vector<const StreamingAudioClip*> tracks)
+	{
+		std::vector<Track> trackList;
+		for (const StreamingAudioClip* clip : tracks)
+			trackList.push_back({ clip, nullptr });
+		SetTrackList(std::move(trackList));
+	}
+	
 	void MusicPlayer::SetTracks(std::vector<const AudioClip*> tracks)
+	{
+		std::vector<Track> trackList;
+		for (const AudioClip* clip : tracks)
+			trackList.push_back({ nullptr, clip });
+		SetTrackList(std::move(trackList));
+	}
+	
+	void MusicPlayer::SetTrackList(std::vector<Track> tracks)
 	{
 		if (!m_tracks.empty())
 		{
@@ -61,12 +141,15 @@ namespace jm
 	
 	void MusicPlayer::Update(float dt)
 	{
-		bool isPlaying = m_source.IsPlaying();
+		bool isPlaying = m_isStreaming ? m_streamingSource.IsPlaying() : m_source.IsPlaying();
 		
 		if (!active)
 		{
 			if (isPlaying)
+			{
+				m_streamingSource.Stop();
 				m_source.Stop();
+			}
 			return;
 		}
 		
@@ -80,10 +163,13 @@ namespace jm
 				m_volumeFade = 1.0f;
 				m_isFadingOut = false;
 				selectNextTrack = true;
+				m_streamingSource.Stop();
 				m_source.Stop();
 			}
 		}
 		
+		//Both sources are kept at the same volume, so the next track starts at the right volume whichever source plays it
+		m_streamingSource.Source().SetVolume(m_volumeFade * volume);
 		m_source.SetVolume(m_volumeFade * volume);
 		
 		if (selectNextTrack && !m_tracks.empty())
@@ -94,8 +180,18 @@ namespace jm
 				std::shuffle(m_tracks.begin(), m_tracks.end(), m_rng);
 			}
 			
-			m_source.SetClip(*m_tracks[m_nextTrack]);
-			m_source.Play();
+			const Track& track = m_tracks[m_nextTrack];
+			m_isStreaming = track.streamingClip != nullptr;
+			if (m_isStreaming)
+			{
+				m_streamingSource.SetClip(*track.streamingClip);
+				m_streamingSource.Play();
+			}
+			else
+			{
+				m_source.SetClip(*track.clip);
+				m_source.Play();
+			}
 			
 			m_nextTrack++;
 		}
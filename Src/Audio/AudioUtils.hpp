@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Audio.hpp"
+#include "StreamingAudio.hpp"
 
 #include <vector>
 #include <pcg_random.hpp>
@@ -13,8 +14,18 @@ namespace jm
 		float pitch = 1;
 		float rolloffFactor = 1;
 		float refDistance = 0;
+		
+		//When all voices are in use, the sound replaces the oldest sound with the lowest priority,
+		// unless all playing sounds have a higher priority than it.
+		int priority = 0;
+		
+		//The maximum number of times the clip can play at once. Playing it more often replaces its oldest instance.
+		int maxInstances = 8;
 	};
 	
+	/***
+	 * Plays a clip on one of a fixed number of sound effect voices.
+	 */
 	JAPI void PlaySoundEffect(const AudioClip& clip, glm::vec3 position, SoundEffectParams params = { });
 	
 	inline void PlaySoundEffect(const AudioClip& clip, glm::vec2 position, SoundEffectParams params = { })
@@ -22,11 +33,30 @@ namespace jm
 		PlaySoundEffect(clip, glm::vec3(position, 0), params);
 	}
 	
+	/***
+	 * Sets the number of sound effects that can play at once, 32 by default. Each voice uses an OpenAL source.
+	 */
+	JAPI void SetMaxSoundEffectVoices(int maxVoices);
+	
+	namespace detail
+	{
+		/***
+		 * Frees the voices of sound effects that have finished playing. Called once per frame.
+		 */
+		void UpdateSoundEffectVoices();
+	}
+	
+	/***
+	 * Plays tracks in a random order, fading out the current track when the tracks are changed.
+	 * Tracks can be StreamingAudioClip, which are loaded from the streaming audio prefix and use less memory,
+	 * or AudioClip, which are decoded fully when loaded.
+	 */
 	class JAPI MusicPlayer
 	{
 	public:
 		MusicPlayer();
 		
+		void SetTracks(std::vector<const StreamingAudioClip*> tracks);
 		void SetTracks(std::vector<const AudioClip*> tracks);
 		
 		void Update(float dt);
@@ -40,8 +70,22 @@ namespace jm
 		bool active = true;
 		
 	private:
+		//Only one of the clips is set
+		struct Track
+		{
+			const StreamingAudioClip* streamingClip;
+			const AudioClip* clip;
+		};
+		
+		void SetTrackList(std::vector<Track> tracks);
+		
+		StreamingAudioSource m_streamingSource;
 		AudioSource m_source;
-		std::vector<const AudioClip*> m_tracks;
+		
+		//Whether the current track is played by m_streamingSource instead of m_source
+		bool m_isStreaming = false;
+		
+		std::vector<Track> m_tracks;
 		size_t m_nextTrack = 0;
 		
 		float m_volumeFadeTimeScale = 1.0f;
@@ -0,0 +1,306 @@
+#include "StreamingAudio.hpp"
+#include "AudioCommand.hpp"
+#include "../Utils.hpp"
+
+#include <AL/al.h>
+#include <algorithm>
+
+#define STB_VORBIS_HEADER_ONLY
+#define STB_VORBIS_NO_STDIO
+#include <stb_vorbis.c>
+
+namespace jm
+{
+	//Each stream keeps this many buffers of STREAM_BUFFER_FRAMES samples per channel queued, which is about
+	// 0.75 seconds of audio at 44.1 kHz. This is much longer than the time between updates, so brief stalls don't cause gaps.
+	static constexpr int NUM_STREAM_BUFFERS = 4;
+	static constexpr int STREAM_BUFFER_FRAMES = 8192;
+	
+	StreamingAudioClip::StreamingAudioClip(std::shared_ptr<const std::vector<char>> fileData, const std::string& name)
+		: m_fileData(std::move(fileData))
+	{
+		int error;
+		stb_vorbis* decoder = stb_vorbis_open_memory(reinterpret_cast<const uint8_t*>(m_fileData->data()),
+			(int)m_fileData->size(), &error, nullptr);
+		if (decoder == nullptr)
+		{
+			Panic(Concat({ "Error loading OGG from '", name, "'." }));
+		}
+		
+		const stb_vorbis_info info = stb_vorbis_get_info(decoder);
+		
+		//Files with more channels are mixed down to stereo by the decoder
+		m_channels = std::min(info.channels, 2);
+		m_sampleRate = (int)info.sample_rate;
+		m_duration = stb_vorbis_stream_length_in_seconds(decoder);
+		
+		stb_vorbis_close(decoder);
+	}
+	
+	struct detail::AudioStream
+	{
+		AudioSource source;
+		ALuint buffers[NUM_STREAM_BUFFERS];
+		
+		std::shared_ptr<const std::vector<char>> fileData;
+		stb_vorbis* decoder = nullptr;
+		int channels = 0;
+		int sampleRate = 0;
+		
+		bool isLooping = false;
+		
+		//Only written by the audio thread
+		std::atomic<bool> isPlaying { false };
+		
+		std::vector<short> samples;
+		
+		AudioStream()
+		{
+			alGenBuffers(NUM_STREAM_BUFFERS, buffers);
+		}
+		
+		//Runs on the audio thread, which also deletes the source directly since commands can't be submitted from it
+		~AudioStream()
+		{
+			DetachBuffers();
+			alDeleteBuffers(NUM_STREAM_BUFFERS, buffers);
+			if (decoder != nullptr)
+				stb_vorbis_close(decoder);
+			
+			DeleteAudioSource(source.m_state);
+			source.m_state = nullptr;
+		}
+		
+		ALuint SourceHandle() const
+		{
+			return source.m_state->handle;
+		}
+		
+		//Stops the source and removes all queued buffers from it
+		void DetachBuffers()
+		{
+			alSourceStop(SourceHandle());
+			alSourcei(SourceHandle(), AL_BUFFER, 0);
+		}
+		
+		void SetClip(const StreamingAudioClip& clip)
+		{
+			if (decoder != nullptr)
+				stb_vorbis_close(decoder);
+			
+			int error;
+			fileData = clip.m_fileData;
+			decoder = stb_vorbis_open_memory(reinterpret_cast<const uint8_t*>(fileData->data()),
+				(int)fileData->size(), &error, nullptr);
+			channels = clip.m_channels;
+			sampleRate = clip.m_sampleRate;
+			samples.resize(STREAM_BUFFER_FRAMES * channels);
+		}
+		
+		//Decodes the next part of the clip into a buffer and queues it. Returns false at the end of a clip that doesn't loop.
+		bool QueueBuffer(ALuint buffer)
+		{
+			int numFrames = 0;
+			bool atStart = false;
+			while (numFrames < STREAM_BUFFER_FRAMES)
+			{
+				const int numDecoded = stb_vorbis_get_samples_short_interleaved(decoder, channels,
+					samples.data() + numFrames * channels, (STREAM_BUFFER_FRAMES - numFrames) * channels);
+				
+				if (numDecoded == 0)
+				{
+					//Nothing is decoded right after seeking to the start if the clip is empty
+					if (!isLooping || atStart)
+						break;
+					stb_vorbis_seek_start(decoder);
+					atStart = true;
+					continue;
+				}
+				
+				numFrames += numDecoded;
+				atStart = false;
+			}
+			
+			if (numFrames == 0)
+				return false;
+			
+			const ALenum format = channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+			alBufferData(buffer, format, samples.data(), numFrames * channels * sizeof(short), sampleRate);
+			alSourceQueueBuffers(SourceHandle(), 1, &buffer);
+			return true;
+		}
+		
+		void Start()
+		{
+			DetachBuffers();
+			
+			int numQueued = 0;
+			if (decoder != nullptr)
+			{
+				stb_vorbis_seek_start(decoder);
+				while (numQueued < NUM_STREAM_BUFFERS && QueueBuffer(buffers[numQueued]))
+					numQueued++;
+			}
+			
+			if (numQueued != 0)
+				alSourcePlay(SourceHandle());
+			isPlaying.store(numQueued != 0, std::memory_order_relaxed);
+		}
+		
+		void Stop()
+		{
+			DetachBuffers();
+			isPlaying.store(false, std::memory_order_relaxed);
+		}
+		
+		void Update()
+		{
+			if (!isPlaying.load(std::memory_order_relaxed))
+				return;
+			
+			ALint numProcessed = 0;
+			alGetSourcei(SourceHandle(), AL_BUFFERS_PROCESSED, &numProcessed);
+			for (ALint i = 0; i < numProcessed; i++)
+			{
+				ALuint buffer;
+				alSourceUnqueueBuffers(SourceHandle(), 1, &buffer);
+				QueueBuffer(buffer);
+			}
+			
+			//The source stops by itself if it plays all queued buffers before they are refilled, or at the end of the clip
+			ALint state;
+			alGetSourcei(SourceHandle(), AL_SOURCE_STATE, &state);
+			if (state != AL_PLAYING)
+			{
+				ALint numQueued = 0;
+				alGetSourcei(SourceHandle(), AL_BUFFERS_QUEUED, &numQueued);
+				if (numQueued > 0)
+					alSourcePlay(SourceHandle());
+				else
+					isPlaying.store(false, std::memory_order_relaxed);
+			}
+		}
+	};
+	
+	//Streams that have been added, only used by the thread applying commands
+	static std::vector<detail::AudioStream*> streams;
+	
+	void detail::UpdateAudioStreams()
+	{
+		for (AudioStream* stream : streams)
+			stream->Update();
+	}
+	
+	void detail::ApplyStreamCommand(AudioCommand& command)
+	{
+		AudioStream* stream = command.stream;
+		switch (command.type)
+		{
+		case AudioCommandType::AddStream:
+			streams.push_back(stream);
+			break;
+		case AudioCommandType::DeleteStream:
+			streams.erase(std::find(streams.begin(), streams.end(), stream));
+			delete stream;
+			break;
+		case AudioCommandType::SetStreamClip:
+			stream->Stop();
+			stream->SetClip(*command.streamClip);
+			delete command.streamClip;
+			break;
+		case AudioCommandType::SetStreamLooping:
+			stream->isLooping = command.intValue != 0;
+			break;
+		case AudioCommandType::PlayStream:
+			stream->Start();
+			break;
+		case AudioCommandType::StopStream:
+			stream->Stop();
+			break;
+		default:
+			break;
+		}
+	}
+	
+	static detail::AudioCommand MakeStreamCommand(detail::AudioCommandType type, detail::AudioStream* stream)
+	{
+		detail::AudioCommand command;
+		command.type = type;
+		command.stream = stream;
+		return command;
+	}
+	
+	StreamingAudioSource::StreamingAudioSource()
+		: m_stream(new detail::AudioStream())
+	{
+		detail::SubmitAudioCommand(MakeStreamCommand(detail::AudioCommandType::AddStream, m_stream));
+	}
+	
+	StreamingAudioSource::~StreamingAudioSource()
+	{
+		if (m_stream != nullptr)
+			detail::SubmitAudioCommand(MakeStreamCommand(detail::AudioCommandType::DeleteStream, m_stream));
+	}
+	
+	StreamingAudioSource::StreamingAudioSource(StreamingAudioSource&& other) noexcept
+		: m_stream(other.m_stream), m_playStopCommandsEnd(other.m_playStopCommandsEnd),
+		  m_playStopIsPlay(other.m_playStopIsPlay)
+	{
+		other.m_stream = nullptr;
+	}
+	
+	StreamingAudioSource& StreamingAudioSource::operator=(StreamingAudioSource&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_stream != nullptr)
+				detail::SubmitAudioCommand(MakeStreamCommand(detail::AudioCommandType::DeleteStream, m_stream));
+			
+			m_stream = other.m_stream;
+			m_playStopCommandsEnd = other.m_playStopCommandsEnd;
+			m_playStopIsPlay = other.m_playStopIsPlay;
+			other.m_stream = nullptr;
+		}
+		return *this;
+	}
+	
+	void StreamingAudioSource::SetClip(const StreamingAudioClip& clip)
+	{
+		//The copy keeps the clip's data alive until the audio thread has opened it
+		detail::AudioCommand command = MakeStreamCommand(detail::AudioCommandType::SetStreamClip, m_stream);
+		command.streamClip = new StreamingAudioClip(clip);
+		m_playStopCommandsEnd = detail::SubmitAudioCommand(command);
+		m_playStopIsPlay = false;
+	}
+	
+	void StreamingAudioSource::SetIsLooping(bool isLooping)
+	{
+		detail::AudioCommand command = MakeStreamCommand(detail::AudioCommandType::SetStreamLooping, m_stream);
+		command.intValue = isLooping;
+		detail::SubmitAudioCommand(command);
+	}
+	
+	void StreamingAudioSource::Play()
+	{
+		m_playStopCommandsEnd = detail::SubmitAudioCommand(MakeStreamCommand(detail::AudioCommandType::PlayStream, m_stream));
+		m_playStopIsPlay = true;
+	}
+	
+	void StreamingAudioSource::Stop()
+	{
+		m_playStopCommandsEnd = detail::SubmitAudioCommand(MakeStreamCommand(detail::AudioCommandType::StopStream, m_stream));
+		m_playStopIsPlay = false;
+	}
+	
+	bool StreamingAudioSource::IsPlaying() const
+	{
+		if (!detail::AudioCommandsApplied(m_playStopCommandsEnd))
+			return m_playStopIsPlay;
+		return m_stream->isPlaying.load(std::memory_order_relaxed);
+	}
+	
+	AudioSource& StreamingAudioSource::Source()
+	{
+		return m_stream->source;
+	}
+}
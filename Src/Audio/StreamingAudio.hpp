@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Audio.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace jm
+{
+	/***
+	 * Ogg Vorbis audio which is kept compressed and decoded a little at a time while it plays, for music and other
+	 * long sounds that would take a lot of memory and loading time to decode fully.
+	 * Ogg files with names starting with the streaming audio prefix are loaded as StreamingAudioClip instead of AudioClip,
+	 * streaming is only used once a prefix has been set with SetStreamingAudioPrefix.
+	 */
+	class JAPI StreamingAudioClip
+	{
+	public:
+		friend struct detail::AudioStream;
+		
+		/***
+		 * Creates a clip from the contents of an Ogg Vorbis file, panics if the file can't be decoded.
+		 * @param name The name of the file, used in error messages.
+		 */
+		StreamingAudioClip(std::shared_ptr<const std::vector<char>> fileData, const std::string& name);
+		
+		int Channels() const
+		{
+			return m_channels;
+		}
+		
+		int SampleRate() const
+		{
+			return m_sampleRate;
+		}
+		
+		//The length of the clip in seconds
+		float Duration() const
+		{
+			return m_duration;
+		}
+		
+		size_t DataBytes() const
+		{
+			return m_fileData->size();
+		}
+		
+	private:
+		std::shared_ptr<const std::vector<char>> m_fileData;
+		int m_channels;
+		int m_sampleRate;
+		float m_duration;
+	};
+	
+	/***
+	 * Plays a StreamingAudioClip by keeping a few buffers of decoded audio queued on a source.
+	 * Buffers that have finished playing are refilled with the next part of the clip on the audio thread.
+	 */
+	class JAPI StreamingAudioSource
+	{
+	public:
+		StreamingAudioSource();
+		~StreamingAudioSource();
+		
+		StreamingAudioSource(StreamingAudioSource&& other) noexcept;
+		StreamingAudioSource& operator=(StreamingAudioSource&& other) noexcept;
+		
+		//Stops the source if it is playing. The clip's data is kept alive by the source.
+		void SetClip(const StreamingAudioClip& clip);
+		
+		void SetIsLooping(bool isLooping);
+		
+		void Play();
+		void Stop();
+		bool IsPlaying() const;
+		
+		/***
+		 * Gets the source that the clip is streamed to, for setting the volume, position and so on.
+		 * SetClip, SetIsLooping, Play and Stop must be called on the StreamingAudioSource instead.
+		 */
+		AudioSource& Source();
+		
+	private:
+		//Deleted by the audio thread, which may still be using it when the StreamingAudioSource is destroyed
+		detail::AudioStream* m_stream;
+		
+		uint64_t m_playStopCommandsEnd = 0;
+		bool m_playStopIsPlay = false;
+	};
+	
+	/***
+	 * Sets the prefix of the names of Ogg files that are loaded as StreamingAudioClip, such as "Music/".
+	 * No files are streamed by default, so all Ogg files are loaded as AudioClip. Must be called before Init.
+	 */
+	JAPI void SetStreamingAudioPrefix(std::string prefix);
+}
@@ -2,18 +2,55 @@
 
 #include <cstring>
 #include <string>
+#include <fstream>
 
 #ifdef __linux__
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <gsl/gsl>
-#include <fstream>
 
 namespace jm::detail
 {
+	AssetData MapAssetFile(const std::string& path)
+	{
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1)
+			return { };
+		
+		auto _f1 = gsl::finally([&] { close(fd); });
+		
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+			return { };
+		const size_t size = fileStat.st_size;
+		
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED)
+		{
+			std::shared_ptr<const void> owner(mapping, [size] (const void* ptr) { munmap(const_cast<void*>(ptr), size); });
+			return AssetData { gsl::span<const char>(static_cast<const char*>(mapping), size), std::move(owner) };
+		}
+		
+		std::vector<char> buffer(size);
+		size_t bytesRead = 0;
+		while (bytesRead < size)
+		{
+			const ssize_t result = read(fd, buffer.data() + bytesRead, size - bytesRead);
+			if (result <= 0)
+				break;
+			bytesRead += result;
+		}
+		buffer.resize(bytesRead);
+		
+		return AssetData::FromBuffer(std::move(buffer));
+	}
+	
 	static bool FindAssetsRec(const std::string& name, size_t prefixLen, ProcessAssetCB processAsset)
 	{
 		DIR* dir = opendir(name.c_str());
@@ -37,22 +74,9 @@ namespace jm::detail
 			{
 				std::string assetName = fullPath.substr(prefixLen);
 				std::string source = fullPath;
-				processAsset(std::move(assetName), std::move(source), [fullPath=std::move(fullPath)] () -> std::vector<char>
+				processAsset(std::move(assetName), std::move(source), [fullPath=std::move(fullPath)] () -> AssetData
 				{
-					std::ifstream stream(fullPath, std::ios::binary);
-					if (!stream)
-						return { };
-					
-					std::vector<char> result;
-					
-					char data[4096];
-					while (!stream.eof())
-					{
-						stream.read(data, sizeof(data));
-						result.insert(result.end(), data, data + stream.gcount());
-					}
-					
-					return result;
+					return MapAssetFile(fullPath);
 				});
 			}
 		}
@@ -71,6 +95,20 @@ namespace jm::detail
 
 namespace jm::detail
 {
+	AssetData MapAssetFile(const std::string& path)
+	{
+		std::ifstream stream(path, std::ios::binary | std::ios::ate);
+		if (!stream)
+			return { };
+		
+		std::vector<char> buffer((size_t)stream.tellg());
+		stream.seekg(0);
+		stream.read(buffer.data(), buffer.size());
+		buffer.resize(stream.gcount());
+		
+		return AssetData::FromBuffer(std::move(buffer));
+	}
+	
 	bool FindAssetsDir(ProcessAssetCB processAsset)
 	{
 		return false;
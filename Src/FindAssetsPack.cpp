@@ -0,0 +1,75 @@
+#include "Asset.hpp"
+#include "AssetPack.hpp"
+#include "Utils.hpp"
+
+#include <miniz.h>
+#include <cstring>
+
+namespace jm::detail
+{
+	bool FindAssetsPack(ProcessAssetCB processAsset)
+	{
+		AssetData pack = MapAssetFile("./assets.pack");
+		if (pack.data.size() < (std::ptrdiff_t)sizeof(PackHeader))
+			return false;
+		
+		PackHeader header;
+		std::memcpy(&header, pack.data.data(), sizeof(PackHeader));
+		if (std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0)
+			return false;
+		if (header.version != PACK_VERSION)
+		{
+			std::cerr << "assets.pack has version " << header.version << ", expected " << PACK_VERSION << ".\n";
+			return false;
+		}
+		
+		const size_t packSize = pack.data.size();
+		const size_t entriesEnd = sizeof(PackHeader) + (size_t)header.numEntries * sizeof(PackEntry);
+		if (entriesEnd > packSize || header.namesOffset + header.namesSize > packSize)
+			Panic("assets.pack is truncated");
+		
+		const char* names = pack.data.data() + header.namesOffset;
+		
+		for (uint32_t i = 0; i < header.numEntries; i++)
+		{
+			PackEntry entry;
+			std::memcpy(&entry, pack.data.data() + sizeof(PackHeader) + i * sizeof(PackEntry), sizeof(PackEntry));
+			
+			if ((uint64_t)entry.nameOffset + entry.nameLength > header.namesSize ||
+			    entry.dataOffset + entry.dataSize > packSize)
+			{
+				Panic("assets.pack is truncated");
+			}
+			
+			std::string name(names + entry.nameOffset, entry.nameLength);
+			
+			//Stored entries are used directly from the mapping, which is kept alive through the asset data
+			const char* entryData = pack.data.data() + entry.dataOffset;
+			if (entry.compression == PackCompression::Stored)
+			{
+				processAsset(std::move(name), { }, [entryData, size = entry.dataSize, owner = pack.owner] () -> AssetData
+				{
+					return AssetData { gsl::span<const char>(entryData, size), owner };
+				});
+				continue;
+			}
+			
+			if (entry.compression != PackCompression::Deflate)
+				Panic("Unknown compression method in assets.pack for " + name);
+			
+			processAsset(std::move(name), { }, [entryData, entry, owner = pack.owner] () -> AssetData
+			{
+				//tinfl_decompress_mem_to_mem doesn't keep any state between calls, so this can run on several
+				// loading threads at once
+				std::vector<char> buffer(entry.uncompressedSize);
+				const size_t decompressedSize = tinfl_decompress_mem_to_mem(buffer.data(), buffer.size(),
+					entryData, entry.dataSize, 0);
+				if (decompressedSize != entry.uncompressedSize)
+					Panic("Corrupt entry in assets.pack");
+				return AssetData::FromBuffer(std::move(buffer));
+			});
+		}
+		
+		return true;
+	}
+}
@@ -1,6 +1,14 @@
 #include "Asset.hpp"
 #include <miniz.h>
 #include <future>
+#include <mutex>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace jm::detail
 {
@@ -10,15 +18,69 @@ namespace jm::detail
 		delete archive;
 	}
 	
+	//Memory maps the archive so that stored entries can be read in place, returns null if that isn't possible.
+	static std::shared_ptr<const char> MapArchive(const char* path, size_t& sizeOut)
+	{
+#ifdef __linux__
+		const int fd = open(path, O_RDONLY);
+		if (fd == -1)
+			return nullptr;
+		
+		struct stat fileStat;
+		void* mapping = MAP_FAILED;
+		if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+		{
+			sizeOut = fileStat.st_size;
+			mapping = mmap(nullptr, sizeOut, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+		
+		if (mapping == MAP_FAILED)
+			return nullptr;
+		
+		const size_t size = sizeOut;
+		return std::shared_ptr<const char>(static_cast<const char*>(mapping), [size] (const char* ptr)
+		{
+			munmap(const_cast<char*>(ptr), size);
+		});
+#else
+		return nullptr;
+#endif
+	}
+	
+	static uint16_t ReadU16LE(const char* data)
+	{
+		return (uint16_t)((uint8_t)data[0] | ((uint8_t)data[1] << 8));
+	}
+	
 	bool FindAssetsZip(ProcessAssetCB processAsset)
 	{
+		const char* path = "./assets.zip";
+		
+		size_t mappingSize = 0;
+		std::shared_ptr<const char> mapping = MapArchive(path, mappingSize);
+		
 		auto* archivePtr = new mz_zip_archive();
-		if (!mz_zip_reader_init_file(archivePtr, "./assets.zip", 0))
+		const bool initialized = mapping != nullptr ?
+			mz_zip_reader_init_mem(archivePtr, mapping.get(), mappingSize, 0) :
+			mz_zip_reader_init_file(archivePtr, path, 0);
+		if (!initialized)
 		{
+			delete archivePtr;
 			return false;
 		}
 		
-		std::shared_ptr<mz_zip_archive> archive(archivePtr, &FreeArchive);
+		//The mapping must outlive the archive reading from it
+		std::shared_ptr<mz_zip_archive> archive(archivePtr, [mapping] (mz_zip_archive* archiveToFree)
+		{
+			FreeArchive(archiveToFree);
+		});
+		
+		//Assets are read from several loading threads. Reading from the mapping doesn't change the archive, so entries
+		// can be extracted concurrently, but without it miniz reads through a single file handle.
+		std::shared_ptr<std::mutex> archiveMutex;
+		if (mapping == nullptr)
+			archiveMutex = std::make_shared<std::mutex>();
 		
 		int numFiles = mz_zip_reader_get_num_files(archive.get());
 		for (int i = 0; i < numFiles; i++)
@@ -31,11 +93,31 @@ namespace jm::detail
 			
 			size_t fileSize = fileStat.m_uncomp_size;
 			
-			processAsset(fileStat.m_filename, { }, [=] () -> std::vector<char>
+			//Uncompressed entries are used directly from the mapping. The data follows the local file header,
+			// which has a 30 byte fixed part followed by the file name and extra field.
+			if (mapping != nullptr && fileStat.m_method == 0 && fileStat.m_comp_size == fileSize &&
+			    (fileStat.m_bit_flag & 1U) == 0 && fileStat.m_local_header_ofs + 30 <= mappingSize)
+			{
+				const char* localHeader = mapping.get() + fileStat.m_local_header_ofs;
+				const size_t dataOffset = fileStat.m_local_header_ofs + 30 + ReadU16LE(localHeader + 26) + ReadU16LE(localHeader + 28);
+				if (ReadU16LE(localHeader) == 0x4b50 && ReadU16LE(localHeader + 2) == 0x0403 && dataOffset + fileSize <= mappingSize)
+				{
+					processAsset(fileStat.m_filename, { }, [=] () -> AssetData
+					{
+						return AssetData { gsl::span<const char>(mapping.get() + dataOffset, fileSize), mapping };
+					});
+					continue;
+				}
+			}
+			
+			processAsset(fileStat.m_filename, { }, [=] () -> AssetData
 			{
 				std::vector<char> extractedData(fileSize);
+				std::unique_lock<std::mutex> lock;
+				if (archiveMutex != nullptr)
+					lock = std::unique_lock<std::mutex>(*archiveMutex);
 				mz_zip_reader_extract_to_mem(archive.get(), i, extractedData.data(), fileSize, 0);
-				return extractedData;
+				return AssetData::FromBuffer(std::move(extractedData));
 			});
 		}
 		
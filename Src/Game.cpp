@@ -5,6 +5,7 @@
 #include "Graphics/Graphics2D.hpp"
 #include "Asset.hpp"
 #include "Audio/Audio.hpp"
+#include "Audio/AudioUtils.hpp"
 #include "SaveFile.hpp"
 
 #include <SDL.h>
@@ -154,6 +155,7 @@ namespace jm
 	
 	inline void Uninit()
 	{
+		detail::StopAssetLoading();
 		delete globalRNG;
 		delete detail::currentIS;
 		delete detail::previousIS;
@@ -178,12 +180,19 @@ namespace jm
 	
 	static std::chrono::high_resolution_clock::time_point lastFrameStart;
 	
+	//Time spent each frame creating assets that have been decoded in the background, so that loading screens keep rendering.
+	static constexpr int64_t ASSET_LOAD_TIME_PER_FRAME_NS = 8000000;
+	
 	void RunOneFrame()
 	{
 		auto thisFrameStart = std::chrono::high_resolution_clock::now();
 		float dt = std::chrono::duration_cast<std::chrono::nanoseconds>(thisFrameStart - lastFrameStart).count() * 1E-9f;
 		lastFrameStart = thisFrameStart;
 		
+		detail::UpdateAssetLoading(ASSET_LOAD_TIME_PER_FRAME_NS);
+		
+		detail::UpdateSoundEffectVoices();
+		
 		if (debugMode)
 		{
 			detail::PollChangedAssets();
@@ -277,6 +286,8 @@ namespace jm
 		
 		game->RunFrame(std::min(dt, 1.0f / 20.0f));
 		
+		detail::FlushAudioCommands();
+		
 		SDL_GL_SwapWindow(window);
 	}
 	
@@ -47,6 +47,54 @@ namespace jm::detail
 		}
 	}
 	
+	uint32_t GetFormatSize(Format format)
+	{
+		switch (format)
+		{
+		case Format::R8_UNorm:
+		case Format::R8_SNorm:
+		case Format::R8_UInt:
+		case Format::R8_SInt:
+			return 1;
+		case Format::R16_UInt:
+		case Format::R16_SInt:
+		case Format::R16_Float:
+		case Format::RG8_UNorm:
+		case Format::RG8_SNorm:
+		case Format::RG8_UInt:
+		case Format::RG8_SInt:
+		case Format::Depth16:
+			return 2;
+		case Format::R32_UInt:
+		case Format::R32_SInt:
+		case Format::R32_Float:
+		case Format::RG16_UInt:
+		case Format::RG16_SInt:
+		case Format::RG16_Float:
+		case Format::RGBA8_UNorm:
+		case Format::RGBA8_SNorm:
+		case Format::RGBA8_UInt:
+		case Format::RGBA8_SInt:
+		case Format::RGBA8_sRGB:
+		case Format::Depth32:
+		case Format::Depth24:
+			return 4;
+		case Format::RG32_UInt:
+		case Format::RG32_SInt:
+		case Format::RG32_Float:
+		case Format::RGBA16_UInt:
+		case Format::RGBA16_SInt:
+		case Format::RGBA16_Float:
+			return 8;
+		case Format::RGBA32_UInt:
+		case Format::RGBA32_SInt:
+		case Format::RGBA32_Float:
+			return 16;
+		default:
+			std::abort();
+		}
+	}
+	
 	uint32_t GetGLDataType(DataType type)
 	{
 		switch (type)
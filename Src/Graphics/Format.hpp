@@ -66,6 +66,9 @@ namespace jm
 	{
 		uint32_t GetGLFormat(Format format);
 		
+		//Gets the number of bytes used by one pixel of a format.
+		uint32_t GetFormatSize(Format format);
+		
 		uint32_t GetGLDataType(DataType type);
 		
 		//Translates a data type and channel count to a texture format for use when uploading texture data.
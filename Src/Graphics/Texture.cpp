@@ -6,6 +6,8 @@
 #include "../Utils.hpp"
 
 #include <stb_image.h>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 namespace jm
@@ -151,55 +153,218 @@ namespace jm
 		)
 	}
 	
-	Texture2D Texture2D::Load(gsl::span<const char> fileData, LoadFlags flags)
+	//Header of .jtex files written by Texture2D::Cook, followed by the mip levels from largest to smallest.
+	struct JTexHeader
 	{
-		bool grayscale = flags & LOAD_GRAYSCALE;
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t channels;
+		uint32_t mipLevels;
+	};
+	
+	static constexpr char JTEX_MAGIC[4] = { 'J', 'T', 'E', 'X' };
+	static constexpr uint32_t JTEX_VERSION = 1;
+	
+	//Rows are padded to the default unpack alignment of 4 so that levels can be uploaded as they are.
+	static size_t MipRowStride(uint32_t width, uint32_t channels, uint32_t level)
+	{
+		return (std::max(width >> level, 1U) * channels + 3) & ~(size_t)3;
+	}
+	
+	static size_t MipLevelSize(uint32_t width, uint32_t height, uint32_t channels, uint32_t level)
+	{
+		return MipRowStride(width, channels, level) * std::max(height >> level, 1U);
+	}
+	
+	//The number of mip levels Cook stores for an image
+	static uint32_t CookedMipLevels(uint32_t width, uint32_t height, Texture2D::LoadFlags flags)
+	{
+		if (flags & Texture2D::LOAD_NO_MIPMAPS)
+			return 1;
+		return std::max(Texture::CalculateMipLevels(std::min(width, height)), 1U);
+	}
+	
+	static Texture2D::DecodedImage DecodeCooked(gsl::span<const char> fileData, Texture2D::LoadFlags flags)
+	{
+		JTexHeader header;
+		std::memcpy(&header, fileData.data(), sizeof(JTexHeader));
+		if (header.version != JTEX_VERSION)
+			Panic("Unsupported .jtex version, the texture should be cooked again.");
+		if (header.width == 0 || header.height == 0 || header.mipLevels == 0 || (header.channels != 1 && header.channels != 4))
+			Panic("Invalid .jtex header.");
+		
+		size_t dataSize = 0;
+		for (uint32_t level = 0; level < header.mipLevels; level++)
+			dataSize += MipLevelSize(header.width, header.height, header.channels, level);
+		if ((size_t)fileData.size() < sizeof(JTexHeader) + dataSize)
+			Panic("Truncated .jtex file.");
+		
+		//The flags can't be applied to cooked data, so they must be the ones the texture was cooked with
+		if ((header.channels == 1) != ((flags & Texture2D::LOAD_GRAYSCALE) != 0))
+			Panic("Cooked texture loaded with a different LOAD_GRAYSCALE flag than it was cooked with.");
+		if (header.mipLevels != CookedMipLevels(header.width, header.height, flags))
+			Panic("Cooked texture loaded with a different LOAD_NO_MIPMAPS flag than it was cooked with.");
+		
+		std::shared_ptr<uint8_t> pixels(new uint8_t[dataSize], std::default_delete<uint8_t[]>());
+		std::memcpy(pixels.get(), fileData.data() + sizeof(JTexHeader), dataSize);
 		
-		int width, height, channels;
+		return Texture2D::DecodedImage { std::move(pixels), header.width, header.height, header.channels, header.mipLevels };
+	}
+	
+	Texture2D::DecodedImage Texture2D::Decode(gsl::span<const char> fileData, LoadFlags flags)
+	{
+		if ((size_t)fileData.size() >= sizeof(JTexHeader) && std::memcmp(fileData.data(), JTEX_MAGIC, sizeof(JTEX_MAGIC)) == 0)
+		{
+			return DecodeCooked(fileData, flags);
+		}
+		
+		const int channels = (flags & LOAD_GRAYSCALE) ? 1 : 4;
+		
+		int width, height, fileChannels;
 		stbi_uc* imageData = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(fileData.data()), fileData.size(),
-			&width, &height, &channels, grayscale ? 1 : 4);
+			&width, &height, &fileChannels, channels);
 		
 		if (imageData == nullptr)
 		{
 			Panic(Concat({ "Failed to load image: ", stbi_failure_reason() }));
 		}
 		
+		return DecodedImage { std::shared_ptr<const uint8_t>(imageData, &stbi_image_free),
+			(uint32_t)width, (uint32_t)height, (uint32_t)channels, 0 };
+	}
+	
+	std::vector<char> Texture2D::Cook(gsl::span<const char> fileData, LoadFlags flags)
+	{
+		const DecodedImage image = Decode(fileData, flags);
+		if (image.mipLevels != 0)
+			return std::vector<char>(fileData.begin(), fileData.end());
+		
+		const uint32_t channels = image.channels;
+		const uint32_t mipLevels = CookedMipLevels(image.width, image.height, flags);
+		
+		size_t dataSize = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+			dataSize += MipLevelSize(image.width, image.height, channels, level);
+		
+		std::vector<char> result(sizeof(JTexHeader) + dataSize);
+		const JTexHeader header = { { JTEX_MAGIC[0], JTEX_MAGIC[1], JTEX_MAGIC[2], JTEX_MAGIC[3] },
+			JTEX_VERSION, image.width, image.height, channels, mipLevels };
+		std::memcpy(result.data(), &header, sizeof(JTexHeader));
+		
+		uint8_t* levelData = reinterpret_cast<uint8_t*>(result.data() + sizeof(JTexHeader));
+		const size_t rowSize = image.width * channels;
+		for (uint32_t y = 0; y < image.height; y++)
+		{
+			std::memcpy(levelData + y * MipRowStride(image.width, channels, 0), image.pixels.get() + y * rowSize, rowSize);
+		}
+		
+		//Each level averages 2x2 blocks of the previous one, like glGenerateMipmap does for non-sRGB formats
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			const uint8_t* srcData = levelData;
+			const uint32_t srcWidth = std::max(image.width >> (level - 1), 1U);
+			const uint32_t srcHeight = std::max(image.height >> (level - 1), 1U);
+			const size_t srcStride = MipRowStride(image.width, channels, level - 1);
+			
+			levelData += MipLevelSize(image.width, image.height, channels, level - 1);
+			const uint32_t width = std::max(image.width >> level, 1U);
+			const uint32_t height = std::max(image.height >> level, 1U);
+			const size_t stride = MipRowStride(image.width, channels, level);
+			
+			for (uint32_t y = 0; y < height; y++)
+			{
+				const uint8_t* srcRow0 = srcData + std::min(y * 2, srcHeight - 1) * srcStride;
+				const uint8_t* srcRow1 = srcData + std::min(y * 2 + 1, srcHeight - 1) * srcStride;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					const uint32_t srcX0 = std::min(x * 2, srcWidth - 1) * channels;
+					const uint32_t srcX1 = std::min(x * 2 + 1, srcWidth - 1) * channels;
+					for (uint32_t c = 0; c < channels; c++)
+					{
+						const uint32_t sum = srcRow0[srcX0 + c] + srcRow0[srcX1 + c] + srcRow1[srcX0 + c] + srcRow1[srcX1 + c];
+						levelData[y * stride + x * channels + c] = (uint8_t)((sum + 2) / 4);
+					}
+				}
+			}
+		}
+		
+		return result;
+	}
+	
+	Texture2D Texture2D::Load(const DecodedImage& image, LoadFlags flags)
+	{
 		Format format = Format::RGBA8_UNorm;
-		if (grayscale)
+		if (image.channels == 1)
 			format = Format::R8_UNorm;
 		else if (flags & LOAD_SRGB)
 			format = Format::RGBA8_sRGB;
 		
-		Texture2D texture(width, height, format, (flags & LOAD_NO_MIPMAPS) ? 1 : 0);
+		//Cooked images already contain their mip chain
+		uint32_t mipLevels = image.mipLevels;
+		if (mipLevels == 0 && (flags & LOAD_NO_MIPMAPS))
+			mipLevels = 1;
 		
-		texture.SetData(0, 0, 0, width, height, DataType::UInt8Norm, channels, imageData);
+		Texture2D texture(image.width, image.height, format, mipLevels);
 		
-		if (!(flags & LOAD_NO_MIPMAPS))
+		if (image.mipLevels != 0)
 		{
-			texture.GenerateMipmaps();
+			const uint8_t* levelData = image.pixels.get();
+			for (uint32_t level = 0; level < image.mipLevels; level++)
+			{
+				texture.SetData(level, 0, 0, std::max(image.width >> level, 1U), std::max(image.height >> level, 1U),
+					DataType::UInt8Norm, image.channels, levelData);
+				levelData += MipLevelSize(image.width, image.height, image.channels, level);
+			}
+		}
+		else
+		{
+			texture.SetData(0, 0, 0, image.width, image.height, DataType::UInt8Norm, image.channels, image.pixels.get());
+			
+			if (!(flags & LOAD_NO_MIPMAPS))
+			{
+				texture.GenerateMipmaps();
+			}
 		}
 		
 		texture.SetMinFilter(TextureMinFilter::LinearMipmapLinear);
 		texture.SetMagFilter(Filter::Nearest);
 		
-		stbi_image_free(imageData);
-		
 		return texture;
 	}
 	
+	size_t Texture2D::MemoryBytes() const
+	{
+		size_t bytes = 0;
+		for (uint32_t level = 0; level < MipLevels(); level++)
+			bytes += (size_t)std::max(m_width >> level, 1U) * std::max(m_height >> level, 1U);
+		return bytes * detail::GetFormatSize(GetFormat());
+	}
+	
 	void Texture2D::RegisterAssetLoader()
 	{
 		stbi_set_flip_vertically_on_load(true);
 		
-		auto assetLoader = [] (gsl::span<const char> fileData, const std::string& name) -> Texture2D
+		//Images are decoded on the loading threads, only the upload happens on the main thread
+		auto decoder = [] (gsl::span<const char> fileData, const std::string& name) -> DecodedImage
+		{
+			return Texture2D::Decode(fileData, (LoadFlags)0);
+		};
+		auto creator = [] (DecodedImage& image, const std::string& name) -> Texture2D
 		{
-			return Texture2D::Load(fileData, (LoadFlags)0);
+			return Texture2D::Load(image, (LoadFlags)0);
 		};
 		
-		jm::RegisterAssetLoader<Texture2D>("png", assetLoader);
-		jm::RegisterAssetLoader<Texture2D>("jpg", assetLoader);
-		jm::RegisterAssetLoader<Texture2D>("jpeg", assetLoader);
-		jm::RegisterAssetLoader<Texture2D>("tga", assetLoader);
+		for (const char* extension : { "png", "jpg", "jpeg", "tga", "jtex" })
+		{
+			jm::RegisterAssetLoader<Texture2D, DecodedImage>(extension, decoder, creator);
+		}
+		
+		SetAssetMemoryUsageCallback<Texture2D>([] (const Texture2D& texture)
+		{
+			return AssetMemoryUsage { sizeof(Texture2D), texture.MemoryBytes(), 0 };
+		});
 	}
 	
 	void UpdateFullscreenTexture(std::optional<Texture2D>& texture, Format format)
@@ -8,6 +8,7 @@
 #include <optional>
 #include <cmath>
 #include <vector>
+#include <memory>
 #include <any>
 #include <gsl/span>
 
@@ -79,13 +80,50 @@ namespace jm
 		void SetData(uint32_t level, uint32_t xOffset, uint32_t yOffset, uint32_t width, uint32_t height,
 		             DataType dataType, uint32_t dataChannels, const void* data);
 		
-		static Texture2D Load(gsl::span<const char> fileData, LoadFlags flags);
+		//Pixels decoded from an image file, in RGBA8 or R8 for grayscale images.
+		struct DecodedImage
+		{
+			std::shared_ptr<const uint8_t> pixels;
+			uint32_t width;
+			uint32_t height;
+			uint32_t channels;
+			
+			//The number of mip levels stored one after another in pixels, with each row padded to 4 bytes.
+			//0 if pixels only contains the full image and mipmaps are generated when the texture is created.
+			uint32_t mipLevels;
+		};
+		
+		/***
+		 * Decodes an image file or a texture cooked by Cook without creating a texture,
+		 * so unlike Load this can be called from any thread. Panics if a cooked texture was cooked with
+		 * different LOAD_GRAYSCALE or LOAD_NO_MIPMAPS flags.
+		 */
+		static DecodedImage Decode(gsl::span<const char> fileData, LoadFlags flags);
+		
+		/***
+		 * Decodes an image file and generates its mip chain, returning the contents of a .jtex file.
+		 * Decode recognizes cooked textures by their contents, so they can keep the name of the source image
+		 * and textures loaded from them are created without decoding the image or generating mipmaps.
+		 */
+		static std::vector<char> Cook(gsl::span<const char> fileData, LoadFlags flags);
+		
+		static Texture2D Load(const DecodedImage& image, LoadFlags flags);
+		
+		static Texture2D Load(gsl::span<const char> fileData, LoadFlags flags)
+		{
+			return Load(Decode(fileData, flags), flags);
+		}
 		
 		static void RegisterAssetLoader();
 		
 		uint32_t Width() const { return m_width; }
 		uint32_t Height() const { return m_height; }
 		
+		/***
+		 * Gets the number of bytes of graphics memory used by the texture, including all mip levels.
+		 */
+		size_t MemoryBytes() const;
+		
 	private:
 		friend void SetRenderTarget(Texture2D* color, Texture2D* depth);
 		
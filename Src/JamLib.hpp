@@ -12,9 +12,15 @@
 #include "World/TileSet.hpp"
 #include "World/TMXTerrain.hpp"
 #include "World/TileSolidityMap.hpp"
+#include "World/TileCostMap.hpp"
 #include "World/GridPathFinder.hpp"
+#include "World/HierarchicalPathFinder.hpp"
+#include "World/PathService.hpp"
+#include "World/FlowField.hpp"
+#include "World/SpatialGrid.hpp"
 #include "Audio/Audio.hpp"
 #include "Audio/AudioUtils.hpp"
+#include "Audio/StreamingAudio.hpp"
 #include "Particles.hpp"
 #include "ParticleEmitterType.hpp"
 #include "SaveFile.hpp"
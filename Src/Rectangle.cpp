@@ -69,6 +69,42 @@ namespace jm
 		);
 	}
 	
+	bool Rectangle::IntersectsRay(glm::vec2 start, glm::vec2 dir, float& tNearOut, glm::vec2& normalOut) const
+	{
+		const glm::vec2 rMin = Min();
+		const glm::vec2 rMax = Max();
+		
+		tNearOut = -INFINITY;
+		float tFar = INFINITY;
+		for (int i = 0; i < 2; i++)
+		{
+			if (dir[i] == 0)
+			{
+				if (start[i] <= rMin[i] || start[i] >= rMax[i])
+					return false;
+				continue;
+			}
+			
+			float t1 = (rMin[i] - start[i]) / dir[i];
+			float t2 = (rMax[i] - start[i]) / dir[i];
+			if (t1 > t2)
+				std::swap(t1, t2);
+			
+			if (t1 > tNearOut)
+			{
+				tNearOut = t1;
+				normalOut = glm::vec2(0);
+				normalOut[i] = dir[i] > 0 ? -1.0f : 1.0f;
+			}
+			tFar = std::min(tFar, t2);
+		}
+		
+		if (tNearOut < 0)
+			normalOut = glm::vec2(0);
+		
+		return tNearOut < tFar && tFar > 0 && tNearOut <= 1;
+	}
+	
 	constexpr float SMALL = 1E-3f;
 	
 	std::pair<bool, float> Rectangle::ClipX(const Rectangle& originRect, const Rectangle& solidRect, float moveX)
@@ -68,6 +68,14 @@ namespace jm
 		
 		bool Intersects(const Rectangle& other) const;
 		
+		/***
+		 * Intersects the ray start + dir * t with the rectangle using the slab method.
+		 * @param tNearOut Receives the value of t where the rectangle is entered, negative if the ray starts inside.
+		 * @param normalOut Receives the normal of the side that was entered, zero if the ray starts inside.
+		 * @return Whether the ray hits the rectangle for some t in [0, 1].
+		 */
+		bool IntersectsRay(glm::vec2 start, glm::vec2 dir, float& tNearOut, glm::vec2& normalOut) const;
+		
 		bool Contains(float px, float py) const;
 		
 		bool Contains(glm::vec2 point) const;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace jm
+{
+	/***
+	 * Fixed capacity queue for passing values from one producer thread to one consumer thread without locking.
+	 */
+	template <typename T>
+	class SPSCQueue
+	{
+	public:
+		/***
+		 * @param capacity The maximum number of values in the queue, rounded up to a power of two.
+		 */
+		explicit SPSCQueue(size_t capacity)
+		{
+			size_t roundedCapacity = 1;
+			while (roundedCapacity < capacity)
+				roundedCapacity *= 2;
+			m_values = std::make_unique<T[]>(roundedCapacity);
+			m_mask = roundedCapacity - 1;
+		}
+		
+		SPSCQueue(const SPSCQueue& other) = delete;
+		SPSCQueue& operator=(const SPSCQueue& other) = delete;
+		
+		/***
+		 * Adds a value to the back of the queue. Must only be called from the producer thread.
+		 * @return False if the queue is full, in which case the value is not added.
+		 */
+		bool Push(T value)
+		{
+			const size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+			if (writeIndex - m_readIndex.load(std::memory_order_acquire) > m_mask)
+				return false;
+			
+			m_values[writeIndex & m_mask] = std::move(value);
+			m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+			return true;
+		}
+		
+		/***
+		 * Removes the value at the front of the queue. Must only be called from the consumer thread.
+		 * @return False if the queue is empty.
+		 */
+		bool Pop(T& valueOut)
+		{
+			const size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+			if (readIndex == m_writeIndex.load(std::memory_order_acquire))
+				return false;
+			
+			valueOut = std::move(m_values[readIndex & m_mask]);
+			m_readIndex.store(readIndex + 1, std::memory_order_release);
+			return true;
+		}
+		
+		size_t Capacity() const
+		{
+			return m_mask + 1;
+		}
+		
+	private:
+		std::unique_ptr<T[]> m_values;
+		size_t m_mask;
+		
+		//The indices only ever increase, and are kept on separate cache lines since they are written by different threads.
+		alignas(64) std::atomic<size_t> m_readIndex { 0 };
+		alignas(64) std::atomic<size_t> m_writeIndex { 0 };
+	};
+}
@@ -51,6 +51,24 @@ namespace jm
 		}
 	};
 	
+	/***
+	 * Returns the index of the lowest set bit in a 64-bit word. The word must not be zero.
+	 */
+	inline int CountTrailingZeros64(uint64_t bits)
+	{
+#if defined(__GNUC__)
+		return __builtin_ctzll(bits);
+#else
+		int count = 0;
+		while (!(bits & 1))
+		{
+			bits >>= 1;
+			count++;
+		}
+		return count;
+#endif
+	}
+	
 	inline int8_t FloatToSNorm(float x)
 	{
 		return (int8_t)(glm::clamp(x, -1.0f, 1.0f) * 127.0f);
@@ -88,7 +106,21 @@ namespace jm
 	 */
 	JAPI std::string_view TrimString(std::string_view input);
 	
-	JAPI uint64_t HashFNV1a64(std::string_view s);
+	//Inline and constexpr so that names can be hashed at compile time, see AssetID.
+	inline constexpr uint64_t HashFNV1a64(std::string_view s)
+	{
+		constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+		constexpr uint64_t FNV_PRIME = 1099511628211ull;
+		
+		uint64_t h = FNV_OFFSET_BASIS;
+		for (char c : s)
+		{
+			h ^= static_cast<uint8_t>(c);
+			h *= FNV_PRIME;
+		}
+		return h;
+	}
+	
 	JAPI uint32_t HashFNV1a32(std::string_view s);
 	
 	class CTStringHash
@@ -0,0 +1,264 @@
+#include "FlowField.hpp"
+#include "TileSolidityMap.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <future>
+
+namespace jm
+{
+	//Offsets to neighboring tiles, ordered so that opposite directions are 4 apart.
+	static const glm::ivec2 directionOffsets[] =
+	{
+		glm::ivec2( 1,  0),
+		glm::ivec2( 1,  1),
+		glm::ivec2( 0,  1),
+		glm::ivec2(-1,  1),
+		glm::ivec2(-1,  0),
+		glm::ivec2(-1, -1),
+		glm::ivec2( 0, -1),
+		glm::ivec2( 1, -1)
+	};
+	
+	static const float directionCosts[] = { 1, M_SQRT2, 1, M_SQRT2, 1, M_SQRT2, 1, M_SQRT2 };
+	
+	static constexpr uint32_t NO_ORIGIN = UINT32_MAX;
+	
+	glm::ivec2 FlowField::DirectionOffset(uint8_t direction)
+	{
+		return direction == NO_DIRECTION ? glm::ivec2(0) : directionOffsets[direction];
+	}
+	
+	void FlowField::Build(const TileSolidityMap& map, gsl::span<const glm::vec2> goals, float maxDistance, uint32_t numThreads)
+	{
+		m_width = map.Width();
+		m_height = map.Height();
+		m_tileSize = glm::vec2(map.TileWidth(), map.TileHeight());
+		m_offset = map.Offset();
+		m_mapID = map.ID();
+		m_mapVersion = map.Version();
+		m_maxDistance = maxDistance;
+		m_numThreads = std::max(numThreads, 1U);
+		
+		m_distances.assign(m_width * m_height, INFINITY);
+		m_directions.assign(m_width * m_height, NO_DIRECTION);
+		m_origins.assign(m_width * m_height, NO_ORIGIN);
+		
+		SetGoalTiles(map, goals);
+		m_goalTiles.swap(m_newGoalTiles);
+		
+		const uint32_t numBands = std::min(m_numThreads, m_height);
+		if (numBands <= 1)
+		{
+			m_heap.clear();
+			for (uint32_t goalTile : m_goalTiles)
+				AddGoal(goalTile, m_heap);
+			Propagate(map, m_heap, 0, m_height);
+			return;
+		}
+		
+		const int rowsPerBand = (m_height + numBands - 1) / numBands;
+		auto BandEnd = [&] (uint32_t band) { return std::min((int)(band + 1) * rowsPerBand, (int)m_height); };
+		
+		std::vector<Heap> heaps(numBands);
+		for (uint32_t goalTile : m_goalTiles)
+			AddGoal(goalTile, heaps[(goalTile / m_width) / rowsPerBand]);
+		
+		while (true)
+		{
+			//Each band only writes to its own rows, so bands can be searched in parallel
+			std::vector<std::future<void>> futures;
+			for (uint32_t b = 1; b < numBands; b++)
+			{
+				if (!heaps[b].empty())
+				{
+					futures.push_back(std::async(std::launch::async, [&, b]
+					{
+						Propagate(map, heaps[b], b * rowsPerBand, BandEnd(b));
+					}));
+				}
+			}
+			
+			Propagate(map, heaps[0], 0, BandEnd(0));
+			
+			for (std::future<void>& future : futures)
+				future.get();
+			
+			//Continues the search across band borders, in both directions
+			bool anyRelaxed = false;
+			for (uint32_t b = 1; b < numBands && (int)b * rowsPerBand < (int)m_height; b++)
+			{
+				const uint32_t y = b * rowsPerBand;
+				for (uint32_t x = 0; x < m_width; x++)
+				{
+					for (uint8_t dir = 0; dir < 8; dir++)
+					{
+						if (directionOffsets[dir].y == -1)
+							anyRelaxed |= Relax(map, y * m_width + x, dir, heaps[b - 1]);
+						else if (directionOffsets[dir].y == 1)
+							anyRelaxed |= Relax(map, (y - 1) * m_width + x, dir, heaps[b]);
+					}
+				}
+			}
+			
+			if (!anyRelaxed)
+				break;
+		}
+	}
+	
+	void FlowField::SetGoals(const TileSolidityMap& map, gsl::span<const glm::vec2> goals)
+	{
+		if (map.ID() != m_mapID || map.Width() != m_width || map.Height() != m_height || map.Version() != m_mapVersion)
+		{
+			Build(map, goals, m_maxDistance, m_numThreads);
+			return;
+		}
+		
+		SetGoalTiles(map, goals);
+		if (m_newGoalTiles == m_goalTiles)
+			return;
+		
+		m_heap.clear();
+		
+		std::vector<uint32_t> removedGoals;
+		std::set_difference(m_goalTiles.begin(), m_goalTiles.end(), m_newGoalTiles.begin(), m_newGoalTiles.end(),
+			std::back_inserter(removedGoals));
+		
+		if (!removedGoals.empty())
+		{
+			//Resets the tiles that were reached from removed goals
+			std::vector<uint32_t> resetTiles;
+			for (uint32_t i = 0; i < m_width * m_height; i++)
+			{
+				if (m_origins[i] != NO_ORIGIN && std::binary_search(removedGoals.begin(), removedGoals.end(), m_origins[i]))
+				{
+					m_distances[i] = INFINITY;
+					m_directions[i] = NO_DIRECTION;
+					m_origins[i] = NO_ORIGIN;
+					resetTiles.push_back(i);
+				}
+			}
+			
+			//The reset tiles are then searched again from the tiles around them that are still reachable
+			for (uint32_t tileIdx : resetTiles)
+			{
+				const glm::ivec2 pos(tileIdx % m_width, tileIdx / m_width);
+				for (uint8_t dir = 0; dir < 8; dir++)
+				{
+					const glm::ivec2 n = pos + directionOffsets[dir];
+					if (map.InRange(n.x, n.y))
+						Relax(map, n.y * m_width + n.x, (dir + 4) % 8, m_heap);
+				}
+			}
+		}
+		
+		for (uint32_t goalTile : m_newGoalTiles)
+		{
+			if (!std::binary_search(m_goalTiles.begin(), m_goalTiles.end(), goalTile))
+				AddGoal(goalTile, m_heap);
+		}
+		
+		Propagate(map, m_heap, 0, m_height);
+		
+		m_goalTiles.swap(m_newGoalTiles);
+	}
+	
+	void FlowField::SetGoalTiles(const TileSolidityMap& map, gsl::span<const glm::vec2> goals)
+	{
+		m_newGoalTiles.clear();
+		for (glm::vec2 goal : goals)
+		{
+			const glm::ivec2 tile = glm::ivec2(glm::floor(map.ToLocal(goal)));
+			if (map.InRange(tile.x, tile.y) && !map.IsSolidUnchecked(tile.x, tile.y))
+				m_newGoalTiles.push_back(tile.y * m_width + tile.x);
+		}
+		
+		std::sort(m_newGoalTiles.begin(), m_newGoalTiles.end());
+		m_newGoalTiles.erase(std::unique(m_newGoalTiles.begin(), m_newGoalTiles.end()), m_newGoalTiles.end());
+	}
+	
+	void FlowField::AddGoal(uint32_t tileIdx, Heap& heap)
+	{
+		m_distances[tileIdx] = 0;
+		m_directions[tileIdx] = NO_DIRECTION;
+		m_origins[tileIdx] = tileIdx;
+		heap.emplace_back(0.0f, tileIdx);
+		std::push_heap(heap.begin(), heap.end(), std::greater<>());
+	}
+	
+	/***
+	 * Updates the tile next to fromIdx in direction dir if it can be reached in a shorter distance through fromIdx.
+	 * @return Whether the tile was updated.
+	 */
+	bool FlowField::Relax(const TileSolidityMap& map, uint32_t fromIdx, uint8_t dir, Heap& heap)
+	{
+		const float distance = m_distances[fromIdx] + directionCosts[dir];
+		if (!(distance < m_maxDistance))
+			return false;
+		
+		const glm::ivec2 from(fromIdx % m_width, fromIdx / m_width);
+		const glm::ivec2 to = from + directionOffsets[dir];
+		if (!map.InRange(to.x, to.y) || map.IsSolidUnchecked(to.x, to.y) ||
+		    map.IsSolidUnchecked(from.x, to.y) || map.IsSolidUnchecked(to.x, from.y))
+		{
+			return false;
+		}
+		
+		const uint32_t toIdx = to.y * m_width + to.x;
+		if (distance >= m_distances[toIdx])
+			return false;
+		
+		m_distances[toIdx] = distance;
+		m_directions[toIdx] = (dir + 4) % 8;
+		m_origins[toIdx] = m_origins[fromIdx];
+		heap.emplace_back(distance, toIdx);
+		std::push_heap(heap.begin(), heap.end(), std::greater<>());
+		return true;
+	}
+	
+	/***
+	 * Runs Dijkstra's algorithm from the tiles in the heap, only updating tiles on rows [beginY, endY).
+	 */
+	void FlowField::Propagate(const TileSolidityMap& map, Heap& heap, int beginY, int endY)
+	{
+		while (!heap.empty())
+		{
+			const auto [distance, idx] = heap.front();
+			std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+			heap.pop_back();
+			
+			if (distance > m_distances[idx])
+				continue;
+			
+			const int y = idx / m_width;
+			for (uint8_t dir = 0; dir < 8; dir++)
+			{
+				const int toY = y + directionOffsets[dir].y;
+				if (toY >= beginY && toY < endY)
+					Relax(map, idx, dir, heap);
+			}
+		}
+	}
+	
+	int FlowField::TileIndex(glm::vec2 pos) const
+	{
+		const glm::ivec2 tile = glm::ivec2(glm::floor((pos - m_offset) / m_tileSize));
+		if (tile.x < 0 || tile.y < 0 || tile.x >= (int)m_width || tile.y >= (int)m_height)
+			return -1;
+		return tile.y * m_width + tile.x;
+	}
+	
+	float FlowField::Distance(glm::vec2 pos) const
+	{
+		const int idx = TileIndex(pos);
+		return idx == -1 ? INFINITY : m_distances[idx];
+	}
+	
+	glm::vec2 FlowField::Direction(glm::vec2 pos) const
+	{
+		const int idx = TileIndex(pos);
+		if (idx == -1 || m_directions[idx] == NO_DIRECTION)
+			return glm::vec2(0);
+		return glm::vec2(directionOffsets[m_directions[idx]]) / directionCosts[m_directions[idx]];
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "../API.hpp"
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#include <gsl/span>
+
+namespace jm
+{
+	/***
+	 * Distance and direction fields towards a set of goal tiles, for moving many agents towards the same goals.
+	 * The fields are built with a single Dijkstra search from all goals at once, moving between tiles the same way
+	 * as GridPathFinder. Agents then look up the direction to move in for their tile in constant time.
+	 */
+	class JAPI FlowField
+	{
+	public:
+		static constexpr uint8_t NO_DIRECTION = 8;
+		
+		FlowField() = default;
+		
+		/***
+		 * Builds the fields from scratch. Goals outside the map or on solid tiles are ignored.
+		 * @param maxDistance Tiles further than this from all goals, in tiles, are treated as unreachable.
+		 * @param numThreads Splits the map into this many horizontal bands that are searched in parallel,
+		 *  repeating the search from band borders until distances across them agree.
+		 */
+		void Build(const class TileSolidityMap& map, gsl::span<const glm::vec2> goals, float maxDistance = INFINITY,
+			uint32_t numThreads = 1);
+		
+		/***
+		 * Changes the goals, only searching from the tiles whose distance changes. The fields are built from scratch
+		 * instead if the map has changed since they were last built, or is a different map.
+		 */
+		void SetGoals(const class TileSolidityMap& map, gsl::span<const glm::vec2> goals);
+		
+		/***
+		 * Gets the distance from a point to the closest goal, in tiles. INFINITY if no goal can be reached.
+		 */
+		float Distance(glm::vec2 pos) const;
+		
+		/***
+		 * Gets the normalized direction to move in from a point to get closer to a goal.
+		 * Zero if the point is on a goal or no goal can be reached.
+		 */
+		glm::vec2 Direction(glm::vec2 pos) const;
+		
+		/***
+		 * Gets the offset to the next tile on the way to a goal for a direction in Directions().
+		 */
+		static glm::ivec2 DirectionOffset(uint8_t direction);
+		
+		/***
+		 * Gets the distance for each tile, stored row by row.
+		 */
+		gsl::span<const float> Distances() const
+		{
+			return m_distances;
+		}
+		
+		/***
+		 * Gets the direction for each tile, stored row by row. NO_DIRECTION for goals and unreachable tiles.
+		 */
+		gsl::span<const uint8_t> Directions() const
+		{
+			return m_directions;
+		}
+		
+		uint32_t Width() const
+		{
+			return m_width;
+		}
+		
+		uint32_t Height() const
+		{
+			return m_height;
+		}
+		
+	private:
+		using Heap = std::vector<std::pair<float, uint32_t>>;
+		
+		void SetGoalTiles(const class TileSolidityMap& map, gsl::span<const glm::vec2> goals);
+		void AddGoal(uint32_t tileIdx, Heap& heap);
+		
+		bool Relax(const class TileSolidityMap& map, uint32_t fromIdx, uint8_t dir, Heap& heap);
+		void Propagate(const class TileSolidityMap& map, Heap& heap, int beginY, int endY);
+		
+		int TileIndex(glm::vec2 pos) const;
+		
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+		glm::vec2 m_tileSize;
+		glm::vec2 m_offset;
+		uint64_t m_mapID = 0;
+		uint64_t m_mapVersion = 0;
+		
+		float m_maxDistance = INFINITY;
+		uint32_t m_numThreads = 1;
+		
+		std::vector<float> m_distances;
+		std::vector<uint8_t> m_directions;
+		
+		//The goal tile that each tile's distance was found from, used to find the tiles affected by removing a goal.
+		std::vector<uint32_t> m_origins;
+		
+		//Indices of the goal tiles, sorted.
+		std::vector<uint32_t> m_goalTiles;
+		std::vector<uint32_t> m_newGoalTiles;
+		
+		Heap m_heap;
+	};
+}
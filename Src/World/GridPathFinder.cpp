@@ -1,7 +1,10 @@
 #include "GridPathFinder.hpp"
 #include "TileSolidityMap.hpp"
+#include "TileCostMap.hpp"
+#include "../Utils.hpp"
 
 #include <algorithm>
+#include <iterator>
 
 namespace jm
 {
@@ -17,7 +20,71 @@ namespace jm
 		{ glm::ivec2(-1, -1), M_SQRT2 }
 	};
 	
-	GridPathFinder::FindResult GridPathFinder::FindPath(const TileSolidityMap& map, glm::vec2 source, glm::vec2 dest, float maxLength)
+	//Returns the index in toNeighbors of the given direction.
+	static uint32_t DirectionIndex(glm::ivec2 dir)
+	{
+		uint32_t i = 0;
+		while (toNeighbors[i].first != dir)
+			i++;
+		return i;
+	}
+	
+	/***
+	 * Moves in a straight line from pos until reaching a jump point or the destination.
+	 * @return The number of steps taken, or 0 if a solid tile or the edge of the map is reached first.
+	 */
+	static int JumpStraight(const TileSolidityMap& map, glm::ivec2 pos, glm::ivec2 dir, glm::ivec2 dest)
+	{
+		const int distance = map.JumpDistance(pos.x, pos.y, dir);
+		
+		const glm::ivec2 toDest = dest - pos;
+		const int destSteps = toDest.x * dir.x + toDest.y * dir.y;
+		if ((dir.x == 0 ? toDest.x : toDest.y) == 0 && destSteps > 0 && destSteps <= std::abs(distance))
+			return destSteps;
+		
+		return std::max(distance, 0);
+	}
+	
+	/***
+	 * Moves diagonally from pos until reaching a tile from which a jump point or the destination can be reached
+	 * by moving straight along either component of the direction.
+	 * @return The number of steps taken, or 0 if the diagonal is blocked first.
+	 */
+	static int JumpDiagonal(const TileSolidityMap& map, glm::ivec2 pos, glm::ivec2 dir, glm::ivec2 dest)
+	{
+		for (int steps = 1;; steps++)
+		{
+			const glm::ivec2 next = pos + dir;
+			if (!map.InRange(next.x, next.y) || map.IsSolidUnchecked(next.x, next.y) ||
+			    map.IsSolidUnchecked(pos.x, next.y) || map.IsSolidUnchecked(next.x, pos.y))
+			{
+				return 0;
+			}
+			
+			pos = next;
+			if (pos == dest || JumpStraight(map, pos, glm::ivec2(dir.x, 0), dest) != 0 ||
+			    JumpStraight(map, pos, glm::ivec2(0, dir.y), dest) != 0)
+			{
+				return steps;
+			}
+		}
+	}
+	
+	GridPathFinder::FindResult GridPathFinder::FindPath(const TileSolidityMap& map, glm::vec2 source, glm::vec2 dest,
+		float maxLength, Algorithm algorithm, uint32_t maxExpansions)
+	{
+		FindResult result = StartSearch(map, source, dest, maxLength, algorithm);
+		if (result != FindResult::InProgress)
+			return result;
+		
+		result = ContinueSearch(maxExpansions);
+		if (result == FindResult::InProgress)
+			return StopSearch();
+		return result;
+	}
+	
+	GridPathFinder::FindResult GridPathFinder::StartSearch(const TileSolidityMap& map, glm::vec2 source, glm::vec2 dest,
+		float maxLength, Algorithm algorithm)
 	{
 		glm::vec2 localSource = map.ToLocal(source);
 		glm::vec2 localDest = map.ToLocal(dest);
@@ -25,6 +92,7 @@ namespace jm
 		const glm::ivec2 sourceI = glm::ivec2(glm::floor(localSource));
 		const glm::ivec2 destI = glm::ivec2(glm::floor(localDest));
 		
+		m_searching = false;
 		if (!map.InRange(sourceI.x, sourceI.y) || map.IsSolidUnchecked(sourceI.x, sourceI.y))
 		{
 			return FindResult::InvalidSource;
@@ -34,79 +102,384 @@ namespace jm
 			return FindResult::InvalidDestination;
 		}
 		
-		//Creates a heap node for the given grid node and cost to reach that grid node.
-		auto MakeHeapNode = [&] (glm::ivec2 node, float cost)
+		//Searching for an unreachable destination would explore everything reachable from the source
+		map.UpdateComponents();
+		if (!map.AreConnected(sourceI, destI))
 		{
-			const glm::ivec2 complete = node - destI;
-			const float h = std::sqrt((float)(complete.x * complete.x + complete.y * complete.y));
-			return HeapNode { node, cost, cost + h };
-		};
+			return FindResult::NoPath;
+		}
+		
+		//Jump point search relies on all moves of the same length having the same cost
+		if (m_costMap != nullptr)
+		{
+			m_costMap->UpdateMoves(map);
+			if (algorithm == Algorithm::JPS)
+				algorithm = Algorithm::AStar;
+		}
 		
-		m_nodes.resize(map.Width() * map.Height());
-		for (Node& node : m_nodes)
-			node.minCost = INFINITY;
+		m_map = &map;
+		m_algorithm = algorithm;
+		m_source = source;
+		m_dest = dest;
+		m_sourceI = sourceI;
+		m_destI = destI;
+		m_maxLength = maxLength;
+		
+		//Starts a new search generation, nodes written by earlier searches are treated as unreached.
+		//Nodes are only reset when the generation counter wraps around.
+		const uint32_t numNodes = map.Width() * map.Height();
+		if (m_nodes.size() < numNodes)
+			m_nodes.resize(numNodes, Node { INFINITY, 0 });
+		if (algorithm == Algorithm::Bidirectional && m_backwardNodes.size() < numNodes)
+			m_backwardNodes.resize(numNodes, Node { INFINITY, 0 });
+		if (++m_generation == (1U << 29U))
+		{
+			for (Node& node : m_nodes)
+				node.generationAndDir = 0;
+			for (Node& node : m_backwardNodes)
+				node.generationAndDir = 0;
+			m_generation = 1;
+		}
+		
+		if (algorithm == Algorithm::JPS)
+		{
+			map.UpdateJumpTables();
+			if (m_parents.size() < numNodes)
+				m_parents.resize(numNodes);
+		}
+		
+		const uint32_t sourceIdx = sourceI.y * map.Width() + sourceI.x;
+		const uint32_t destIdx = destI.y * map.Width() + destI.x;
 		
 		m_heap.clear();
-		m_heap.reserve(m_nodes.size() * 2);
-		m_heap.push_back(MakeHeapNode(sourceI, 0));
-		m_nodes[sourceI.y * map.Width() + sourceI.x].minCost = 0;
+		PushNode(m_nodes, m_heap, sourceIdx, sourceI, destI, 0, 0);
+		m_closestNodeIdx = sourceIdx;
+		m_closestDistance = INFINITY;
 		
-		//A*
-		while (!m_heap.empty() && m_heap[0].node != destI)
+		if (algorithm == Algorithm::Bidirectional)
 		{
-			HeapNode cur = m_heap[0];
-			std::pop_heap(m_heap.begin(), m_heap.end());
-			m_heap.pop_back();
+			m_backwardHeap.clear();
+			PushNode(m_backwardNodes, m_backwardHeap, destIdx, destI, sourceI, 0, 0);
+			m_meetingNodeIdx = sourceIdx;
+			m_meetingCost = sourceIdx == destIdx ? 0 : INFINITY;
+		}
+		
+		m_searching = true;
+		return FindResult::InProgress;
+	}
+	
+	GridPathFinder::FindResult GridPathFinder::ContinueSearch(uint32_t maxExpansions, int64_t timeLimitNS)
+	{
+		if (!m_searching)
+			Panic("GridPathFinder::ContinueSearch called without a search in progress");
+		
+		const int64_t startTime = timeLimitNS == INT64_MAX ? 0 : NanoTime();
+		for (uint32_t i = 0; i < maxExpansions; i++)
+		{
+			//Reading the clock is relatively expensive compared to expanding a node, so it's only done every few nodes
+			if (timeLimitNS != INT64_MAX && i % 64 == 63 && NanoTime() - startTime > timeLimitNS)
+				break;
 			
-			if (cur.cost > m_nodes[cur.node.y * map.Width() + cur.node.x].minCost)
-				continue;
+			StepResult stepResult;
+			switch (m_algorithm)
+			{
+			case Algorithm::AStar: stepResult = StepAStar(); break;
+			case Algorithm::JPS: stepResult = StepJPS(); break;
+			case Algorithm::Bidirectional: stepResult = StepBidirectional(); break;
+			}
 			
-			for (std::pair<glm::ivec2, float> toNeighbor : toNeighbors)
+			if (stepResult == StepResult::Found)
 			{
-				glm::ivec2 n = cur.node + toNeighbor.first;
-				if (!map.InRange(n.x, n.y) || map.IsSolidUnchecked(n.x, n.y) ||
-				    map.IsSolidUnchecked(cur.node.x, n.y) || map.IsSolidUnchecked(n.x, cur.node.y))
-				{
-					continue;
-				}
-				
-				uint32_t idx = n.y * map.Width() + n.x;
-				float cost = cur.cost + toNeighbor.second;
-				if (cost < m_nodes[idx].minCost && cost < maxLength)
+				m_searching = false;
+				if (m_algorithm == Algorithm::Bidirectional)
+					BuildPath(m_meetingNodeIdx, true);
+				else
+					BuildPath(m_destI.y * m_map->Width() + m_destI.x, true);
+				return FindResult::Success;
+			}
+			if (stepResult == StepResult::NoPath)
+			{
+				m_searching = false;
+				return FindResult::NoPath;
+			}
+		}
+		
+		return FindResult::InProgress;
+	}
+	
+	GridPathFinder::FindResult GridPathFinder::StopSearch()
+	{
+		if (!m_searching)
+			Panic("GridPathFinder::StopSearch called without a search in progress");
+		
+		m_searching = false;
+		BuildPath(m_closestNodeIdx, false);
+		return FindResult::Partial;
+	}
+	
+	void GridPathFinder::BuildPath(uint32_t endIdx, bool reachedDest)
+	{
+		const uint32_t width = m_map->Width();
+		auto PrevNode = [&] (const std::vector<Node>& nodes, glm::ivec2 n)
+		{
+			const uint32_t idx = n.y * width + n.x;
+			if (m_algorithm == Algorithm::JPS)
+				return glm::ivec2(m_parents[idx] % width, m_parents[idx] / width);
+			return n - toNeighbors[nodes[idx].generationAndDir & 0b111U].first;
+		};
+		
+		//Follows parents from the last tile in m_cellPath to the target. Jump points can be several tiles apart,
+		// the tiles between them are added as well so that smoothing works the same for all algorithms.
+		auto AddTilesTo = [&] (const std::vector<Node>& nodes, glm::ivec2 target)
+		{
+			for (glm::ivec2 n = m_cellPath.back(); n != target;)
+			{
+				const glm::ivec2 prev = PrevNode(nodes, n);
+				const glm::ivec2 step = glm::sign(prev - n);
+				while (n != prev)
 				{
-					m_nodes[idx].minCost = cost;
-					m_nodes[idx].prev = cur.node;
-					m_heap.push_back(MakeHeapNode(n, cost));
-					std::push_heap(m_heap.begin(), m_heap.end());
+					n += step;
+					m_cellPath.push_back(n);
 				}
 			}
+		};
+		
+		m_cellPath.clear();
+		m_cellPath.emplace_back(endIdx % width, endIdx / width);
+		if (reachedDest && m_algorithm == Algorithm::Bidirectional)
+		{
+			AddTilesTo(m_backwardNodes, m_destI);
+			std::reverse(m_cellPath.begin(), m_cellPath.end());
 		}
+		AddTilesTo(m_nodes, m_sourceI);
 		
-		if (m_heap[0].node != destI)
-			return FindResult::NoPath;
+		const glm::vec2 tileSize(m_map->TileWidth(), m_map->TileHeight());
 		
 		//Constructs a temporary path back
 		m_tempPath.clear();
-		m_tempPath.push_back(dest);
-		for (glm::ivec2 n = m_nodes[destI.y * map.Width() + destI.x].prev; n != sourceI;
-			n = m_nodes[n.y * map.Width() + n.x].prev)
+		m_tempPath.push_back(reachedDest ? m_dest : (glm::vec2(m_cellPath[0]) + 0.5f) * tileSize + m_map->Offset());
+		for (size_t i = 1; i + 1 < m_cellPath.size(); i++)
 		{
-			m_tempPath.push_back((glm::vec2(n) + 0.5f) * glm::vec2(map.TileWidth(), map.TileHeight()) + map.Offset());
+			m_tempPath.push_back((glm::vec2(m_cellPath[i]) + 0.5f) * tileSize + m_map->Offset());
 		}
-		m_tempPath.push_back(source);
+		m_tempPath.push_back(m_source);
 		
 		//Smooths the path back by removing unnecessary points
 		m_finalPath.clear();
 		m_finalPath.push_back(m_tempPath.back());
 		for (int64_t i = (int64_t)m_tempPath.size() - 2; i >= 0; i--)
 		{
-			if (map.LineIntersectsSolid(m_finalPath.back(), m_tempPath[i]))
+			if (m_map->LineIntersectsSolid(m_finalPath.back(), m_tempPath[i]))
 			{
 				m_finalPath.emplace_back(m_tempPath[i + 1]);
 			}
 		}
 		m_finalPath.emplace_back(m_tempPath[0]);
+	}
+	
+	void GridPathFinder::PushNode(std::vector<Node>& nodes, std::vector<HeapNode>& heap, uint32_t nodeIdx,
+		glm::ivec2 pos, glm::ivec2 target, float cost, uint32_t dir)
+	{
+		const glm::vec2 complete(pos - target);
+		const float h = std::sqrt(complete.x * complete.x + complete.y * complete.y);
+		
+		nodes[nodeIdx] = Node { cost, (m_generation << 3U) | dir };
+		heap.push_back(HeapNode { nodeIdx, cost, cost + h });
+		std::push_heap(heap.begin(), heap.end());
+	}
+	
+	void GridPathFinder::DiscardOutdated(std::vector<HeapNode>& heap, const std::vector<Node>& nodes)
+	{
+		//Nodes are pushed again when a cheaper way to them is found, rather than being updated in the heap
+		while (!heap.empty() && heap[0].cost > nodes[heap[0].nodeIdx].minCost)
+		{
+			std::pop_heap(heap.begin(), heap.end());
+			heap.pop_back();
+		}
+	}
+	
+	GridPathFinder::HeapNode GridPathFinder::PopNode(std::vector<HeapNode>& heap)
+	{
+		HeapNode node = heap[0];
+		std::pop_heap(heap.begin(), heap.end());
+		heap.pop_back();
+		
+		//Tracks the node closest to the destination for partial paths
+		const float distance = node.costWithHeuristic - node.cost;
+		if (&heap == &m_heap && distance < m_closestDistance)
+		{
+			m_closestDistance = distance;
+			m_closestNodeIdx = node.nodeIdx;
+		}
+		
+		return node;
+	}
+	
+	/***
+	 * Invokes callback(dir, neighbor, moveCost) for each neighbor that can be moved to from pos.
+	 * With a cost map, moves are weighted by the cost of the tile entered. Backward searches follow moves in reverse,
+	 * so the tile entered is pos rather than the neighbor.
+	 */
+	template <typename CallbackTp>
+	void GridPathFinder::ForEachMove(glm::ivec2 pos, bool backward, CallbackTp callback) const
+	{
+		if (m_costMap != nullptr)
+		{
+			const TileCostMap::Cell& cell = m_costMap->GetCellUnchecked(pos.x, pos.y);
+			for (uint32_t dir = 0; dir < std::size(toNeighbors); dir++)
+			{
+				if (((cell.moves >> dir) & 1U) == 0)
+					continue;
+				
+				const glm::ivec2 n = pos + toNeighbors[dir].first;
+				const uint8_t cost = backward ? cell.cost : m_costMap->GetCellUnchecked(n.x, n.y).cost;
+				callback(dir, n, toNeighbors[dir].second * (float)cost);
+			}
+			return;
+		}
+		
+		const TileSolidityMap& map = *m_map;
+		for (uint32_t dir = 0; dir < std::size(toNeighbors); dir++)
+		{
+			glm::ivec2 n = pos + toNeighbors[dir].first;
+			if (!map.InRange(n.x, n.y) || map.IsSolidUnchecked(n.x, n.y) ||
+			    map.IsSolidUnchecked(pos.x, n.y) || map.IsSolidUnchecked(n.x, pos.y))
+			{
+				continue;
+			}
+			callback(dir, n, toNeighbors[dir].second);
+		}
+	}
+	
+	GridPathFinder::StepResult GridPathFinder::StepAStar()
+	{
+		const uint32_t width = m_map->Width();
+		
+		DiscardOutdated(m_heap, m_nodes);
+		if (m_heap.empty())
+			return StepResult::NoPath;
+		if (m_heap[0].nodeIdx == m_destI.y * width + m_destI.x)
+			return StepResult::Found;
+		
+		const HeapNode cur = PopNode(m_heap);
+		const glm::ivec2 curPos(cur.nodeIdx % width, cur.nodeIdx / width);
+		ForEachMove(curPos, false, [&] (uint32_t dir, glm::ivec2 n, float moveCost)
+		{
+			uint32_t idx = n.y * width + n.x;
+			float cost = cur.cost + moveCost;
+			if ((!IsNodeValid(m_nodes[idx]) || cost < m_nodes[idx].minCost) && cost < m_maxLength)
+			{
+				PushNode(m_nodes, m_heap, idx, n, m_destI, cost, dir);
+			}
+		});
+		
+		return StepResult::Expanded;
+	}
+	
+	GridPathFinder::StepResult GridPathFinder::StepJPS()
+	{
+		const TileSolidityMap& map = *m_map;
+		const uint32_t width = map.Width();
+		
+		DiscardOutdated(m_heap, m_nodes);
+		if (m_heap.empty())
+			return StepResult::NoPath;
+		if (m_heap[0].nodeIdx == m_destI.y * width + m_destI.x)
+			return StepResult::Found;
+		
+		const HeapNode cur = PopNode(m_heap);
+		
+		//Selects the directions to search in. Other neighbors can be reached at least as cheaply
+		// without passing through this node, given the direction it was reached from.
+		glm::ivec2 dirs[8];
+		uint32_t numDirs = 0;
+		if (cur.nodeIdx == m_sourceI.y * width + m_sourceI.x)
+		{
+			for (const std::pair<glm::ivec2, float>& toNeighbor : toNeighbors)
+				dirs[numDirs++] = toNeighbor.first;
+		}
+		else
+		{
+			const glm::ivec2 reachedDir = toNeighbors[m_nodes[cur.nodeIdx].generationAndDir & 0b111U].first;
+			if (reachedDir.x != 0 && reachedDir.y != 0)
+			{
+				dirs[numDirs++] = glm::ivec2(reachedDir.x, 0);
+				dirs[numDirs++] = glm::ivec2(0, reachedDir.y);
+				dirs[numDirs++] = reachedDir;
+			}
+			else
+			{
+				const glm::ivec2 sideDir(reachedDir.y, reachedDir.x);
+				dirs[numDirs++] = reachedDir;
+				dirs[numDirs++] = reachedDir + sideDir;
+				dirs[numDirs++] = reachedDir - sideDir;
+				dirs[numDirs++] = sideDir;
+				dirs[numDirs++] = -sideDir;
+			}
+		}
+		
+		const glm::ivec2 curPos(cur.nodeIdx % width, cur.nodeIdx / width);
+		for (uint32_t i = 0; i < numDirs; i++)
+		{
+			const bool diagonal = dirs[i].x != 0 && dirs[i].y != 0;
+			const int steps = diagonal ? JumpDiagonal(map, curPos, dirs[i], m_destI) : JumpStraight(map, curPos, dirs[i], m_destI);
+			if (steps == 0)
+				continue;
+			
+			const glm::ivec2 n = curPos + dirs[i] * steps;
+			const uint32_t idx = n.y * width + n.x;
+			const uint32_t dir = DirectionIndex(dirs[i]);
+			const float cost = cur.cost + toNeighbors[dir].second * (float)steps;
+			if ((!IsNodeValid(m_nodes[idx]) || cost < m_nodes[idx].minCost) && cost < m_maxLength)
+			{
+				PushNode(m_nodes, m_heap, idx, n, m_destI, cost, dir);
+				m_parents[idx] = cur.nodeIdx;
+			}
+		}
+		
+		return StepResult::Expanded;
+	}
+	
+	GridPathFinder::StepResult GridPathFinder::StepBidirectional()
+	{
+		const uint32_t width = m_map->Width();
+		
+		DiscardOutdated(m_heap, m_nodes);
+		DiscardOutdated(m_backwardHeap, m_backwardNodes);
+		
+		//If either search runs out of nodes, every path has been found. Otherwise any path not found yet
+		// is at least as long as the lowest estimate in both directions.
+		if (m_heap.empty() || m_backwardHeap.empty())
+			return m_meetingCost < m_maxLength ? StepResult::Found : StepResult::NoPath;
+		const float lowerBound = std::max(m_heap[0].costWithHeuristic, m_backwardHeap[0].costWithHeuristic);
+		if (m_meetingCost <= lowerBound || lowerBound >= m_maxLength)
+			return m_meetingCost < m_maxLength ? StepResult::Found : StepResult::NoPath;
+		
+		//Expands a node from the search with fewer open nodes
+		const bool forward = m_heap.size() <= m_backwardHeap.size();
+		std::vector<HeapNode>& heap = forward ? m_heap : m_backwardHeap;
+		std::vector<Node>& nodes = forward ? m_nodes : m_backwardNodes;
+		const std::vector<Node>& otherNodes = forward ? m_backwardNodes : m_nodes;
+		const glm::ivec2 target = forward ? m_destI : m_sourceI;
+		
+		const HeapNode cur = PopNode(heap);
+		const glm::ivec2 curPos(cur.nodeIdx % width, cur.nodeIdx / width);
+		ForEachMove(curPos, !forward, [&] (uint32_t dir, glm::ivec2 n, float moveCost)
+		{
+			uint32_t idx = n.y * width + n.x;
+			float cost = cur.cost + moveCost;
+			if ((!IsNodeValid(nodes[idx]) || cost < nodes[idx].minCost) && cost < m_maxLength)
+			{
+				PushNode(nodes, heap, idx, n, target, cost, dir);
+				
+				if (IsNodeValid(otherNodes[idx]) && cost + otherNodes[idx].minCost < m_meetingCost)
+				{
+					m_meetingCost = cost + otherNodes[idx].minCost;
+					m_meetingNodeIdx = idx;
+				}
+			}
+		});
 		
-		return FindResult::Success;
+		return StepResult::Expanded;
 	}
 }
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 
 #include <vector>
+#include <cstdint>
 #include <future>
 
 #include "../API.hpp"
@@ -17,13 +18,75 @@ namespace jm
 			Success,
 			NoPath,
 			InvalidSource,
-			InvalidDestination
+			InvalidDestination,
+			
+			//The search ran out of node expansions before reaching the destination,
+			// the path leads to the explored tile closest to the destination.
+			Partial,
+			
+			//The search has not finished yet, returned by StartSearch and ContinueSearch.
+			InProgress
+		};
+		
+		enum class Algorithm
+		{
+			AStar,
+			
+			//Jump point search, finds paths of the same length as A* while expanding far fewer nodes on open maps.
+			//Uses jump distance tables stored in the map, see TileSolidityMap::UpdateJumpTables.
+			//A* is used instead when a cost map is set.
+			JPS,
+			
+			//A* from both the source and the destination, finds paths of the same length as A*.
+			//Unreachable destinations are detected after exploring the smaller of the two regions.
+			Bidirectional
 		};
 		
 		GridPathFinder() = default;
 		
+		/***
+		 * Sets the movement costs used by later searches, or nullptr to give all tiles the same cost.
+		 * The cost map must have the same size as the maps searched, and outlive the searches.
+		 * With a cost map, maxLength limits the total cost of the path rather than its length.
+		 */
+		void SetCostMap(const class TileCostMap* costMap)
+		{
+			m_costMap = costMap;
+		}
+		
+		/***
+		 * Finds a path between two points.
+		 * @param maxExpansions The maximum number of nodes to expand. If the destination hasn't been reached
+		 *  by then, the result is Partial.
+		 */
 		FindResult FindPath(const class TileSolidityMap& map, glm::vec2 localSource, glm::vec2 localDest,
-			float maxLength = INFINITY);
+			float maxLength = INFINITY, Algorithm algorithm = Algorithm::AStar, uint32_t maxExpansions = UINT32_MAX);
+		
+		/***
+		 * Starts a search that can be spread over several frames using ContinueSearch.
+		 * The map must not be modified or destroyed until the search has finished.
+		 * @return InProgress, or InvalidSource or InvalidDestination.
+		 */
+		FindResult StartSearch(const class TileSolidityMap& map, glm::vec2 localSource, glm::vec2 localDest,
+			float maxLength = INFINITY, Algorithm algorithm = Algorithm::AStar);
+		
+		/***
+		 * Continues a search started by StartSearch until it finishes, maxExpansions nodes have been expanded
+		 * or timeLimitNS nanoseconds have passed.
+		 * @return InProgress if the search hasn't finished, otherwise Success or NoPath.
+		 */
+		FindResult ContinueSearch(uint32_t maxExpansions = UINT32_MAX, int64_t timeLimitNS = INT64_MAX);
+		
+		/***
+		 * Ends an unfinished search, making the path lead to the explored tile closest to the destination.
+		 * @return Partial.
+		 */
+		FindResult StopSearch();
+		
+		bool IsSearching() const
+		{
+			return m_searching;
+		}
 		
 		const std::vector<glm::vec2>& Path() const
 		{
@@ -31,15 +94,26 @@ namespace jm
 		}
 		
 	private:
+		enum class StepResult
+		{
+			Expanded,
+			Found,
+			NoPath
+		};
+		
 		struct Node
 		{
 			float minCost;
-			glm::ivec2 prev;
+			
+			//The search generation that last wrote the node in the upper 29 bits,
+			// and the index of the direction the node was reached from in the lower 3 bits.
+			//For jump point search this is the direction of the jump from the parent node.
+			uint32_t generationAndDir;
 		};
 		
 		struct HeapNode
 		{
-			glm::ivec2 node;
+			uint32_t nodeIdx;
 			float cost;
 			float costWithHeuristic;
 			
@@ -49,9 +123,55 @@ namespace jm
 			}
 		};
 		
+		void PushNode(std::vector<Node>& nodes, std::vector<HeapNode>& heap, uint32_t nodeIdx,
+			glm::ivec2 pos, glm::ivec2 target, float cost, uint32_t dir);
+		void DiscardOutdated(std::vector<HeapNode>& heap, const std::vector<Node>& nodes);
+		HeapNode PopNode(std::vector<HeapNode>& heap);
+		
+		template <typename CallbackTp>
+		void ForEachMove(glm::ivec2 pos, bool backward, CallbackTp callback) const;
+		
+		StepResult StepAStar();
+		StepResult StepJPS();
+		StepResult StepBidirectional();
+		
+		void BuildPath(uint32_t endIdx, bool reachedDest);
+		
+		//Returns whether the node has been reached during the current search
+		bool IsNodeValid(const Node& node) const
+		{
+			return (node.generationAndDir >> 3U) == m_generation;
+		}
+		
+		const class TileCostMap* m_costMap = nullptr;
+		const class TileSolidityMap* m_map = nullptr;
+		bool m_searching = false;
+		Algorithm m_algorithm = Algorithm::AStar;
+		glm::vec2 m_source;
+		glm::vec2 m_dest;
+		glm::ivec2 m_sourceI;
+		glm::ivec2 m_destI;
+		float m_maxLength = INFINITY;
+		
+		//The expanded node with the lowest heuristic, used as the end of partial paths.
+		uint32_t m_closestNodeIdx = 0;
+		float m_closestDistance = INFINITY;
+		
 		std::vector<HeapNode> m_heap;
 		
 		std::vector<Node> m_nodes;
+		uint32_t m_generation = 0;
+		
+		//Parent node indices, only written by jump point search since jump points aren't adjacent to their parents.
+		std::vector<uint32_t> m_parents;
+		
+		//State for the search from the destination used by bidirectional search.
+		std::vector<HeapNode> m_backwardHeap;
+		std::vector<Node> m_backwardNodes;
+		uint32_t m_meetingNodeIdx = 0;
+		float m_meetingCost = INFINITY;
+		
+		std::vector<glm::ivec2> m_cellPath;
 		
 		std::vector<glm::vec2> m_tempPath;
 		std::vector<glm::vec2> m_finalPath;
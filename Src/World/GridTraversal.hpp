@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstdlib>
+
+namespace jm::detail
+{
+	/***
+	 * Visits each grid cell touched by a line segment in order (Amanatides & Woo), all coordinates are in cell space.
+	 * If the line passes exactly through a corner, both cells adjacent to the corner are visited.
+	 * The callback receives the cell, the segment fraction where the cell is entered and the entry normal.
+	 * Traversal stops when the callback returns true.
+	 */
+	template <typename CallbackTp>
+	void TraverseGridLine(glm::vec2 localStart, glm::vec2 localEnd, CallbackTp callback)
+	{
+		const glm::vec2 delta = localEnd - localStart;
+		
+		glm::ivec2 cell(glm::floor(localStart));
+		const glm::ivec2 endCell(glm::floor(localEnd));
+		const glm::ivec2 step((delta.x > 0) - (delta.x < 0), (delta.y > 0) - (delta.y < 0));
+		
+		//Segment fraction where the next tile boundary is crossed along each axis, and the distance between boundaries.
+		glm::vec2 tMax(INFINITY);
+		glm::vec2 tDelta(INFINITY);
+		for (int i = 0; i < 2; i++)
+		{
+			if (step[i] != 0)
+			{
+				tMax[i] = ((float)(cell[i] + (step[i] > 0 ? 1 : 0)) - localStart[i]) / delta[i];
+				tDelta[i] = (float)step[i] / delta[i];
+			}
+		}
+		
+		if (callback(cell, 0.0f, glm::vec2(0)))
+			return;
+		
+		int remainingSteps = std::abs(endCell.x - cell.x) + std::abs(endCell.y - cell.y);
+		while (remainingSteps > 0)
+		{
+			if (tMax.x < tMax.y)
+			{
+				cell.x += step.x;
+				if (callback(cell, tMax.x, glm::vec2(-step.x, 0)))
+					return;
+				tMax.x += tDelta.x;
+				remainingSteps--;
+			}
+			else if (tMax.y < tMax.x)
+			{
+				cell.y += step.y;
+				if (callback(cell, tMax.y, glm::vec2(0, -step.y)))
+					return;
+				tMax.y += tDelta.y;
+				remainingSteps--;
+			}
+			else
+			{
+				const float t = tMax.x;
+				if (callback(glm::ivec2(cell.x + step.x, cell.y), t, glm::vec2(-step.x, 0)) ||
+				    callback(glm::ivec2(cell.x, cell.y + step.y), t, glm::vec2(0, -step.y)))
+				{
+					return;
+				}
+				
+				cell += step;
+				if (callback(cell, t, glm::vec2(-step.x, -step.y)))
+					return;
+				tMax += tDelta;
+				remainingSteps -= 2;
+			}
+		}
+	}
+}
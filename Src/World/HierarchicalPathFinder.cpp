@@ -0,0 +1,489 @@
+#include "HierarchicalPathFinder.hpp"
+#include "TileSolidityMap.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+namespace jm
+{
+	static const glm::ivec2 LINK_DIRECTIONS[] =
+	{
+		glm::ivec2( 1,  0),
+		glm::ivec2(-1,  0),
+		glm::ivec2( 0,  1),
+		glm::ivec2( 0, -1)
+	};
+	
+	static const std::pair<glm::ivec2, float> toNeighbors[] =
+	{
+		{ glm::ivec2(-1,  0), 1 },
+		{ glm::ivec2( 1,  0), 1 },
+		{ glm::ivec2( 0, -1), 1 },
+		{ glm::ivec2( 0,  1), 1 },
+		{ glm::ivec2(-1,  1), M_SQRT2 },
+		{ glm::ivec2( 1,  1), M_SQRT2 },
+		{ glm::ivec2( 1, -1), M_SQRT2 },
+		{ glm::ivec2(-1, -1), M_SQRT2 }
+	};
+	
+	//Openings along a cluster border at least this wide get a transition at each end instead of one in the middle.
+	static constexpr int WIDE_ENTRANCE_LENGTH = 6;
+	
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+	
+	/***
+	 * Runs Dijkstra's algorithm from the start tile, only moving between tiles inside the cluster.
+	 * The shortest distance to each reached tile is then available through LocalCost.
+	 * @param stopCallback Invoked with the index of each tile relative to the cluster when its shortest distance is
+	 *  known, the search stops if it returns true.
+	 */
+	template <typename CallbackTp>
+	void HierarchicalPathFinder::SearchCluster(const Cluster& cluster, glm::ivec2 start, CallbackTp stopCallback)
+	{
+		const glm::ivec2 size = cluster.max - cluster.min;
+		m_localNodes.assign(size.x * size.y, LocalNode { INFINITY, 0 });
+		
+		const glm::ivec2 startLocal = start - cluster.min;
+		m_localNodes[startLocal.y * size.x + startLocal.x].cost = 0;
+		
+		m_localHeap.clear();
+		m_localHeap.emplace_back(0.0f, startLocal.y * size.x + startLocal.x);
+		
+		while (!m_localHeap.empty())
+		{
+			const auto [cost, idx] = m_localHeap.front();
+			std::pop_heap(m_localHeap.begin(), m_localHeap.end(), std::greater<>());
+			m_localHeap.pop_back();
+			
+			if (cost > m_localNodes[idx].cost)
+				continue;
+			
+			if (stopCallback(idx))
+				break;
+			
+			const glm::ivec2 pos = cluster.min + glm::ivec2(idx % size.x, idx / size.x);
+			
+			for (uint8_t dir = 0; dir < std::size(toNeighbors); dir++)
+			{
+				const glm::ivec2 n = pos + toNeighbors[dir].first;
+				if (n.x < cluster.min.x || n.y < cluster.min.y || n.x >= cluster.max.x || n.y >= cluster.max.y ||
+				    m_map->IsSolidUnchecked(n.x, n.y) || m_map->IsSolidUnchecked(pos.x, n.y) ||
+				    m_map->IsSolidUnchecked(n.x, pos.y))
+				{
+					continue;
+				}
+				
+				const glm::ivec2 nLocal = n - cluster.min;
+				const uint32_t nIdx = nLocal.y * size.x + nLocal.x;
+				const float nCost = cost + toNeighbors[dir].second;
+				if (nCost < m_localNodes[nIdx].cost)
+				{
+					m_localNodes[nIdx] = LocalNode { nCost, dir };
+					m_localHeap.emplace_back(nCost, nIdx);
+					std::push_heap(m_localHeap.begin(), m_localHeap.end(), std::greater<>());
+				}
+			}
+		}
+	}
+	
+	float HierarchicalPathFinder::LocalCost(const Cluster& cluster, glm::ivec2 tile) const
+	{
+		const glm::ivec2 local = tile - cluster.min;
+		return m_localNodes[local.y * (cluster.max.x - cluster.min.x) + local.x].cost;
+	}
+	
+	HierarchicalPathFinder::HierarchicalPathFinder(const TileSolidityMap& map, uint32_t clusterSize)
+		: m_map(&map), m_clusterSize(clusterSize)
+	{
+		if (clusterSize == 0)
+			Panic("HierarchicalPathFinder created with a cluster size of 0");
+		
+		BuildAllClusters();
+	}
+	
+	void HierarchicalPathFinder::BuildAllClusters()
+	{
+		m_mapID = m_map->ID();
+		m_mapWidth = m_map->Width();
+		m_mapHeight = m_map->Height();
+		m_mapVersion = m_map->Version();
+		
+		m_numClustersX = (m_mapWidth + m_clusterSize - 1) / m_clusterSize;
+		m_numClustersY = (m_mapHeight + m_clusterSize - 1) / m_clusterSize;
+		m_clusters.assign(m_numClustersX * m_numClustersY, Cluster());
+		
+		for (uint32_t cy = 0; cy < m_numClustersY; cy++)
+		{
+			for (uint32_t cx = 0; cx < m_numClustersX; cx++)
+			{
+				Cluster& cluster = m_clusters[cy * m_numClustersX + cx];
+				cluster.min = glm::ivec2(cx, cy) * (int)m_clusterSize;
+				cluster.max = glm::min(cluster.min + (int)m_clusterSize, glm::ivec2(m_mapWidth, m_mapHeight));
+				BuildCluster(cluster);
+			}
+		}
+		
+		AssignNodeIds();
+	}
+	
+	bool HierarchicalPathFinder::MapReplaced() const
+	{
+		return m_map->ID() != m_mapID || m_map->Width() != m_mapWidth || m_map->Height() != m_mapHeight;
+	}
+	
+	void HierarchicalPathFinder::Update()
+	{
+		//A map assigned over the bound one can have any version, so all clusters are rebuilt
+		if (MapReplaced())
+		{
+			BuildAllClusters();
+			return;
+		}
+		
+		if (m_map->Version() == m_mapVersion)
+			return;
+		
+		for (Cluster& cluster : m_clusters)
+		{
+			//Transitions depend on the tiles just outside the cluster as well
+			const glm::ivec2 size = cluster.max - cluster.min;
+			if (m_map->RegionChangedSince(cluster.min.x - 1, cluster.min.y - 1, size.x + 2, size.y + 2, m_mapVersion))
+			{
+				BuildCluster(cluster);
+			}
+		}
+		
+		AssignNodeIds();
+		m_mapVersion = m_map->Version();
+	}
+	
+	void HierarchicalPathFinder::AssignNodeIds()
+	{
+		m_numNodes = 0;
+		m_nodeClusterIndices.clear();
+		for (uint32_t i = 0; i < m_clusters.size(); i++)
+		{
+			m_clusters[i].firstNodeId = m_numNodes;
+			m_numNodes += m_clusters[i].nodes.size();
+			m_nodeClusterIndices.resize(m_numNodes, i);
+		}
+	}
+	
+	void HierarchicalPathFinder::BuildCluster(Cluster& cluster)
+	{
+		cluster.nodes.clear();
+		cluster.nodeLinks.clear();
+		
+		//Both clusters on each side of a border find the transitions with the same arguments, so that they agree
+		const glm::ivec2 size = cluster.max - cluster.min;
+		if (cluster.max.x < (int)m_map->Width())
+			AddBorderNodes(cluster, glm::ivec2(cluster.max.x - 1, cluster.min.y), { 0, 1 }, { 1, 0 }, size.y, false);
+		if (cluster.min.x > 0)
+			AddBorderNodes(cluster, glm::ivec2(cluster.min.x - 1, cluster.min.y), { 0, 1 }, { 1, 0 }, size.y, true);
+		if (cluster.max.y < (int)m_map->Height())
+			AddBorderNodes(cluster, glm::ivec2(cluster.min.x, cluster.max.y - 1), { 1, 0 }, { 0, 1 }, size.x, false);
+		if (cluster.min.y > 0)
+			AddBorderNodes(cluster, glm::ivec2(cluster.min.x, cluster.min.y - 1), { 1, 0 }, { 0, 1 }, size.x, true);
+		
+		const size_t numNodes = cluster.nodes.size();
+		m_localNodeIndices.assign(size.x * size.y, -1);
+		for (size_t i = 0; i < numNodes; i++)
+		{
+			const glm::ivec2 local = cluster.nodes[i] - cluster.min;
+			m_localNodeIndices[local.y * size.x + local.x] = (int)i;
+		}
+		
+		//Distances are symmetric, so each search only needs to reach the nodes after the one it starts from
+		cluster.distances.assign(numNodes * numNodes, INFINITY);
+		for (size_t i = 0; i + 1 < numNodes; i++)
+		{
+			size_t nodesLeft = numNodes - i - 1;
+			SearchCluster(cluster, cluster.nodes[i], [&] (uint32_t localIdx)
+			{
+				return m_localNodeIndices[localIdx] > (int)i && --nodesLeft == 0;
+			});
+			
+			for (size_t j = i + 1; j < numNodes; j++)
+			{
+				const float distance = LocalCost(cluster, cluster.nodes[j]);
+				cluster.distances[i * numNodes + j] = distance;
+				cluster.distances[j * numNodes + i] = distance;
+			}
+		}
+	}
+	
+	/***
+	 * Adds nodes for the transitions across one border of a cluster.
+	 * @param borderStart The first tile on the near side of the border.
+	 * @param along The direction to move along the border.
+	 * @param across The direction to move across the border.
+	 * @param farSide Whether the cluster is on the far side of the border.
+	 */
+	void HierarchicalPathFinder::AddBorderNodes(Cluster& cluster, glm::ivec2 borderStart, glm::ivec2 along,
+		glm::ivec2 across, int length, bool farSide)
+	{
+		auto IsOpen = [&] (int i)
+		{
+			const glm::ivec2 nearTile = borderStart + along * i;
+			const glm::ivec2 farTile = nearTile + across;
+			return !m_map->IsSolidUnchecked(nearTile.x, nearTile.y) && !m_map->IsSolidUnchecked(farTile.x, farTile.y);
+		};
+		
+		const uint8_t linkBit = 1 << ((across.x != 0 ? 0 : 2) + (farSide ? 1 : 0));
+		
+		auto AddNode = [&] (int i)
+		{
+			const glm::ivec2 tile = borderStart + along * i + (farSide ? across : glm::ivec2(0));
+			
+			//Tiles in the corners of a cluster can have transitions across two borders
+			for (size_t n = 0; n < cluster.nodes.size(); n++)
+			{
+				if (cluster.nodes[n] == tile)
+				{
+					cluster.nodeLinks[n] |= linkBit;
+					return;
+				}
+			}
+			cluster.nodes.push_back(tile);
+			cluster.nodeLinks.push_back(linkBit);
+		};
+		
+		for (int i = 0; i < length;)
+		{
+			if (!IsOpen(i))
+			{
+				i++;
+				continue;
+			}
+			
+			int end = i + 1;
+			while (end < length && IsOpen(end))
+				end++;
+			
+			if (end - i >= WIDE_ENTRANCE_LENGTH)
+			{
+				AddNode(i);
+				AddNode(end - 1);
+			}
+			else
+			{
+				AddNode((i + end) / 2);
+			}
+			
+			i = end;
+		}
+	}
+	
+	HierarchicalPathFinder::FindResult HierarchicalPathFinder::FindPath(glm::vec2 source, glm::vec2 dest,
+		uint32_t clustersToRefine)
+	{
+		Update();
+		
+		m_abstractPath.clear();
+		m_abstractPathWorld.clear();
+		m_path.clear();
+		m_nextSegment = 0;
+		
+		const glm::ivec2 sourceI = glm::ivec2(glm::floor(m_map->ToLocal(source)));
+		const glm::ivec2 destI = glm::ivec2(glm::floor(m_map->ToLocal(dest)));
+		
+		if (!m_map->InRange(sourceI.x, sourceI.y) || m_map->IsSolidUnchecked(sourceI.x, sourceI.y))
+		{
+			return FindResult::InvalidSource;
+		}
+		if (!m_map->InRange(destI.x, destI.y) || m_map->IsSolidUnchecked(destI.x, destI.y))
+		{
+			return FindResult::InvalidDestination;
+		}
+		
+		m_map->UpdateComponents();
+		if (!m_map->AreConnected(sourceI, destI))
+		{
+			return FindResult::NoPath;
+		}
+		
+		//The destination is given the id after the last node
+		const uint32_t destId = m_numNodes;
+		if (m_searchNodes.size() < m_numNodes + 1)
+			m_searchNodes.resize(m_numNodes + 1, SearchNode { INFINITY, 0, NO_PARENT });
+		if (++m_generation == 0)
+		{
+			for (SearchNode& node : m_searchNodes)
+				node.generation = 0;
+			m_generation = 1;
+		}
+		
+		m_heap.clear();
+		auto PushNode = [&] (uint32_t id, glm::ivec2 tile, float cost, uint32_t parent)
+		{
+			SearchNode& node = m_searchNodes[id];
+			if (node.generation == m_generation && node.cost <= cost)
+				return;
+			node = SearchNode { cost, m_generation, parent };
+			
+			const glm::vec2 toDest(destI - tile);
+			m_heap.push_back(HeapNode { id, cost, cost + std::sqrt(toDest.x * toDest.x + toDest.y * toDest.y) });
+			std::push_heap(m_heap.begin(), m_heap.end());
+		};
+		
+		//Finds the distances from the destination to the nodes in its cluster
+		const uint32_t destClusterIdx = ClusterIndex(destI);
+		const Cluster& destCluster = m_clusters[destClusterIdx];
+		SearchCluster(destCluster, destI, [] (uint32_t) { return false; });
+		m_destCosts.clear();
+		for (glm::ivec2 node : destCluster.nodes)
+			m_destCosts.push_back(LocalCost(destCluster, node));
+		
+		//Connects the source to the nodes in its cluster, and directly to the destination if it's in the same cluster
+		const Cluster& sourceCluster = m_clusters[ClusterIndex(sourceI)];
+		SearchCluster(sourceCluster, sourceI, [] (uint32_t) { return false; });
+		for (size_t i = 0; i < sourceCluster.nodes.size(); i++)
+		{
+			const float cost = LocalCost(sourceCluster, sourceCluster.nodes[i]);
+			if (cost != INFINITY)
+				PushNode(sourceCluster.firstNodeId + i, sourceCluster.nodes[i], cost, NO_PARENT);
+		}
+		if (&sourceCluster == &destCluster && LocalCost(sourceCluster, destI) != INFINITY)
+			PushNode(destId, destI, LocalCost(sourceCluster, destI), NO_PARENT);
+		
+		//A* through the cluster graph
+		while (!m_heap.empty() && m_heap[0].id != destId)
+		{
+			HeapNode cur = m_heap[0];
+			std::pop_heap(m_heap.begin(), m_heap.end());
+			m_heap.pop_back();
+			
+			if (cur.cost > m_searchNodes[cur.id].cost)
+				continue;
+			
+			const uint32_t clusterIdx = m_nodeClusterIndices[cur.id];
+			const Cluster& cluster = m_clusters[clusterIdx];
+			const uint32_t local = cur.id - cluster.firstNodeId;
+			const glm::ivec2 pos = cluster.nodes[local];
+			
+			for (uint32_t i = 0; i < cluster.nodes.size(); i++)
+			{
+				const float distance = cluster.distances[local * cluster.nodes.size() + i];
+				if (i != local && distance != INFINITY)
+					PushNode(cluster.firstNodeId + i, cluster.nodes[i], cur.cost + distance, cur.id);
+			}
+			
+			for (uint32_t l = 0; l < std::size(LINK_DIRECTIONS); l++)
+			{
+				if (!(cluster.nodeLinks[local] & (1 << l)))
+					continue;
+				
+				const glm::ivec2 linkedPos = pos + LINK_DIRECTIONS[l];
+				const Cluster& linkedCluster = m_clusters[ClusterIndex(linkedPos)];
+				const uint32_t linkedLocal = std::find(linkedCluster.nodes.begin(), linkedCluster.nodes.end(), linkedPos) -
+					linkedCluster.nodes.begin();
+				PushNode(linkedCluster.firstNodeId + linkedLocal, linkedPos, cur.cost + 1, cur.id);
+			}
+			
+			if (clusterIdx == destClusterIdx && m_destCosts[local] != INFINITY)
+				PushNode(destId, destI, cur.cost + m_destCosts[local], cur.id);
+		}
+		
+		if (m_heap.empty())
+			return FindResult::NoPath;
+		
+		m_abstractPath.push_back(destI);
+		for (uint32_t id = m_searchNodes[destId].parent; id != NO_PARENT; id = m_searchNodes[id].parent)
+		{
+			m_abstractPath.push_back(m_clusters[m_nodeClusterIndices[id]].nodes[id - m_clusters[m_nodeClusterIndices[id]].firstNodeId]);
+		}
+		m_abstractPath.push_back(sourceI);
+		std::reverse(m_abstractPath.begin(), m_abstractPath.end());
+		
+		//The source and destination can be on transition tiles
+		m_abstractPath.erase(std::unique(m_abstractPath.begin(), m_abstractPath.end()), m_abstractPath.end());
+		
+		for (glm::ivec2 tile : m_abstractPath)
+		{
+			m_abstractPathWorld.push_back((glm::vec2(tile) + 0.5f) * glm::vec2(m_map->TileWidth(), m_map->TileHeight()) + m_map->Offset());
+		}
+		m_abstractPathWorld.front() = source;
+		m_abstractPathWorld.back() = dest;
+		
+		m_dest = dest;
+		m_lastRawPoint = source;
+		m_path.push_back(source);
+		m_nextSegment = 1;
+		if (m_abstractPath.size() == 1)
+			m_path.push_back(dest);
+		
+		Refine(clustersToRefine);
+		return FindResult::Success;
+	}
+	
+	bool HierarchicalPathFinder::Refine(uint32_t maxClusters)
+	{
+		//The path was found on a map that has since been replaced, and may not even be in range
+		if (MapReplaced())
+			return false;
+		
+		uint32_t clustersRefined = 0;
+		while (m_nextSegment < m_abstractPath.size())
+		{
+			const glm::ivec2 from = m_abstractPath[m_nextSegment - 1];
+			const glm::ivec2 to = m_abstractPath[m_nextSegment];
+			
+			m_segmentTiles.clear();
+			if (ClusterIndex(from) != ClusterIndex(to))
+			{
+				//Transition to a neighboring cluster
+				if (m_map->IsSolidUnchecked(to.x, to.y))
+					return false;
+				m_segmentTiles.push_back(to);
+			}
+			else
+			{
+				if (clustersRefined == maxClusters)
+					break;
+				clustersRefined++;
+				
+				const Cluster& cluster = m_clusters[ClusterIndex(from)];
+				const glm::ivec2 toLocal = to - cluster.min;
+				const uint32_t toIdx = toLocal.y * (cluster.max.x - cluster.min.x) + toLocal.x;
+				SearchCluster(cluster, from, [&] (uint32_t localIdx) { return localIdx == toIdx; });
+				if (LocalCost(cluster, to) == INFINITY)
+					return false;
+				
+				for (glm::ivec2 tile = to; tile != from;)
+				{
+					m_segmentTiles.push_back(tile);
+					const glm::ivec2 local = tile - cluster.min;
+					tile -= toNeighbors[m_localNodes[local.y * (cluster.max.x - cluster.min.x) + local.x].dir].first;
+				}
+				std::reverse(m_segmentTiles.begin(), m_segmentTiles.end());
+			}
+			
+			m_nextSegment++;
+			
+			const bool isLast = m_nextSegment == m_abstractPath.size();
+			for (glm::ivec2 tile : m_segmentTiles)
+			{
+				if (!isLast || tile != to)
+					AddRawPoint((glm::vec2(tile) + 0.5f) * glm::vec2(m_map->TileWidth(), m_map->TileHeight()) + m_map->Offset());
+			}
+			
+			if (isLast)
+			{
+				AddRawPoint(m_dest);
+				m_path.push_back(m_dest);
+			}
+		}
+		
+		return true;
+	}
+	
+	void HierarchicalPathFinder::AddRawPoint(glm::vec2 point)
+	{
+		//Smooths the path the same way as GridPathFinder, a point is only kept if the next one can't be seen
+		// from the last point that was kept.
+		if (m_map->LineIntersectsSolid(m_path.back(), point))
+			m_path.push_back(m_lastRawPoint);
+		m_lastRawPoint = point;
+	}
+}
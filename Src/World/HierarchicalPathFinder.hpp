@@ -0,0 +1,168 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "../API.hpp"
+#include "GridPathFinder.hpp"
+
+namespace jm
+{
+	/***
+	 * Finds paths using hierarchical pathfinding (HPA*). The map is split into square clusters, and transitions
+	 * between neighboring clusters are connected by precomputed distances within each cluster.
+	 * Paths are first found through this graph and then refined into tiles a few clusters at a time.
+	 * The map must outlive the path finder. Clusters affected by changes to the map are rebuilt by the next search.
+	 */
+	class JAPI HierarchicalPathFinder
+	{
+	public:
+		using FindResult = GridPathFinder::FindResult;
+		
+		explicit HierarchicalPathFinder(const class TileSolidityMap& map, uint32_t clusterSize = 16);
+		
+		/***
+		 * Finds a path through the cluster graph. Only the first part of the path is refined, use Refine to refine
+		 * more of it. The path is not always the shortest one, since it has to pass through cluster transitions.
+		 */
+		FindResult FindPath(glm::vec2 source, glm::vec2 dest, uint32_t clustersToRefine = 2);
+		
+		/***
+		 * Refines the path found by FindPath through up to maxClusters more clusters, appending to Path().
+		 * @return False if the path is blocked by changes to the map since it was found, true otherwise.
+		 */
+		bool Refine(uint32_t maxClusters);
+		
+		/***
+		 * Rebuilds clusters affected by changes to the map, or all clusters if another map was assigned to it.
+		 * This is called by FindPath.
+		 */
+		void Update();
+		
+		/***
+		 * Gets the path refined so far, from the source to the destination once IsComplete returns true.
+		 * Points are smoothed as tiles are refined, so until the path is complete it can end slightly before
+		 * the last refined tile.
+		 */
+		const std::vector<glm::vec2>& Path() const
+		{
+			return m_path;
+		}
+		
+		/***
+		 * Gets the unrefined path, going from the source through the centers of the cluster transitions to the destination.
+		 */
+		const std::vector<glm::vec2>& AbstractPath() const
+		{
+			return m_abstractPathWorld;
+		}
+		
+		bool IsComplete() const
+		{
+			return m_nextSegment == m_abstractPath.size();
+		}
+		
+		uint32_t ClusterSize() const
+		{
+			return m_clusterSize;
+		}
+		
+	private:
+		struct Cluster
+		{
+			//Tiles in the cluster are in the range [min, max)
+			glm::ivec2 min;
+			glm::ivec2 max;
+			
+			//Transition tiles on the border of the cluster. For each tile the bits in nodeLinks are set for
+			// the directions (indices into LINK_DIRECTIONS) in which there is a transition to the neighboring cluster.
+			std::vector<glm::ivec2> nodes;
+			std::vector<uint8_t> nodeLinks;
+			
+			//Shortest distances within the cluster between each pair of nodes, INFINITY if not connected.
+			std::vector<float> distances;
+			
+			uint32_t firstNodeId;
+		};
+		
+		uint32_t ClusterIndex(glm::ivec2 tile) const
+		{
+			return (tile.y / m_clusterSize) * m_numClustersX + tile.x / m_clusterSize;
+		}
+		
+		void BuildCluster(Cluster& cluster);
+		void BuildAllClusters();
+		bool MapReplaced() const;
+		void AssignNodeIds();
+		void AddBorderNodes(Cluster& cluster, glm::ivec2 borderStart, glm::ivec2 along, glm::ivec2 across,
+			int length, bool farSide);
+		
+		template <typename CallbackTp>
+		void SearchCluster(const Cluster& cluster, glm::ivec2 start, CallbackTp stopCallback);
+		float LocalCost(const Cluster& cluster, glm::ivec2 tile) const;
+		
+		void AddRawPoint(glm::vec2 point);
+		
+		const class TileSolidityMap* m_map;
+		uint32_t m_clusterSize;
+		uint32_t m_numClustersX;
+		uint32_t m_numClustersY;
+		std::vector<Cluster> m_clusters;
+		uint32_t m_numNodes = 0;
+		std::vector<uint32_t> m_nodeClusterIndices;
+		
+		//The map's ID, size and version when the clusters were built. Clusters are all rebuilt if a different map
+		// is assigned to the bound one.
+		uint64_t m_mapID = 0;
+		uint32_t m_mapWidth = 0;
+		uint32_t m_mapHeight = 0;
+		uint64_t m_mapVersion = 0;
+		
+		//Search state for the cluster graph, stamped with the search generation like GridPathFinder.
+		struct SearchNode
+		{
+			float cost;
+			uint32_t generation;
+			uint32_t parent;
+		};
+		
+		struct HeapNode
+		{
+			uint32_t id;
+			float cost;
+			float costWithHeuristic;
+			
+			bool operator<(const HeapNode& other) const
+			{
+				return costWithHeuristic > other.costWithHeuristic;
+			}
+		};
+		
+		std::vector<SearchNode> m_searchNodes;
+		std::vector<HeapNode> m_heap;
+		uint32_t m_generation = 0;
+		std::vector<float> m_destCosts;
+		
+		//Search state for Dijkstra's algorithm within a single cluster.
+		struct LocalNode
+		{
+			float cost;
+			uint8_t dir;
+		};
+		
+		std::vector<LocalNode> m_localNodes;
+		std::vector<int> m_localNodeIndices;
+		std::vector<std::pair<float, uint32_t>> m_localHeap;
+		
+		std::vector<glm::ivec2> m_abstractPath;
+		std::vector<glm::vec2> m_abstractPathWorld;
+		size_t m_nextSegment = 0;
+		
+		glm::vec2 m_dest;
+		glm::vec2 m_lastRawPoint;
+		std::vector<glm::ivec2> m_segmentTiles;
+		std::vector<glm::vec2> m_path;
+	};
+}
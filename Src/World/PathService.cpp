@@ -0,0 +1,140 @@
+#include "PathService.hpp"
+#include "TileSolidityMap.hpp"
+
+#include <cstring>
+
+namespace jm
+{
+	bool detail::PathRequestKey::operator==(const PathRequestKey& other) const
+	{
+		//Compared bytewise to be consistent with the hash
+		return std::memcmp(this, &other, sizeof(PathRequestKey)) == 0;
+	}
+	
+	size_t detail::PathRequestKeyHash::operator()(const PathRequestKey& key) const
+	{
+		return HashFNV1a64(std::string_view(reinterpret_cast<const char*>(&key), sizeof(PathRequestKey)));
+	}
+	
+	PathService::PathService(uint32_t numThreads)
+	{
+		//Without threads, requests are searched for by Dispatch instead
+#ifndef __EMSCRIPTEN__
+		if (numThreads == 0)
+			numThreads = std::max(std::thread::hardware_concurrency(), 2U) - 1;
+		
+		for (uint32_t i = 0; i < numThreads; i++)
+			m_threads.emplace_back(&PathService::WorkerMain, this);
+#endif
+	}
+	
+	PathService::~PathService()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_stopping = true;
+		}
+		m_queueSignal.notify_all();
+		
+		for (std::thread& thread : m_threads)
+			thread.join();
+	}
+	
+	void PathService::SetMap(const TileSolidityMap& map)
+	{
+		m_map = std::make_shared<const TileSolidityMap>(map);
+		
+		//Workers check connectivity before searching, the labels are brought up to date here so they only read them
+		m_map->UpdateComponents();
+		m_requests.clear();
+	}
+	
+	PathHandle PathService::Request(glm::vec2 source, glm::vec2 dest, float maxLength, GridPathFinder::Algorithm algorithm)
+	{
+		if (m_map == nullptr)
+			Panic("PathService::Request called before SetMap");
+		
+		const detail::PathRequestKey key = { source, dest, maxLength, (uint32_t)algorithm };
+		
+		std::weak_ptr<detail::PathJob>& existing = m_requests[key];
+		if (std::shared_ptr<detail::PathJob> job = existing.lock())
+			return PathHandle(std::move(job));
+		
+		auto job = std::make_shared<detail::PathJob>();
+		job->key = key;
+		job->map = m_map;
+		existing = job;
+		m_undispatchedJobs.push_back(job);
+		return PathHandle(std::move(job));
+	}
+	
+	void PathService::Dispatch()
+	{
+		//Forgets requests whose handles have all been dropped
+		for (auto it = m_requests.begin(); it != m_requests.end();)
+		{
+			if (it->second.expired())
+				it = m_requests.erase(it);
+			else
+				++it;
+		}
+		
+		if (m_undispatchedJobs.empty())
+			return;
+		
+		for (const std::shared_ptr<detail::PathJob>& job : m_undispatchedJobs)
+		{
+			//Jump tables are built here, since the workers would otherwise build them concurrently on the same snapshot
+			if (job->key.algorithm == (uint32_t)GridPathFinder::Algorithm::JPS)
+				job->map->UpdateJumpTables();
+		}
+		
+		if (m_threads.empty())
+		{
+			GridPathFinder pathFinder;
+			for (const std::shared_ptr<detail::PathJob>& job : m_undispatchedJobs)
+				RunPathJob(pathFinder, *job);
+		}
+		else
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_queueMutex);
+				m_queue.insert(m_queue.end(), m_undispatchedJobs.begin(), m_undispatchedJobs.end());
+			}
+			m_queueSignal.notify_all();
+		}
+		
+		m_undispatchedJobs.clear();
+	}
+	
+	void PathService::RunPathJob(GridPathFinder& pathFinder, detail::PathJob& job)
+	{
+		job.result = pathFinder.FindPath(*job.map, job.key.source, job.key.dest, job.key.maxLength,
+			(GridPathFinder::Algorithm)job.key.algorithm);
+		if (job.result == GridPathFinder::FindResult::Success)
+			job.path = pathFinder.Path();
+		
+		job.done.store(true, std::memory_order_release);
+	}
+	
+	void PathService::WorkerMain()
+	{
+		GridPathFinder pathFinder;
+		
+		while (true)
+		{
+			std::shared_ptr<detail::PathJob> job;
+			{
+				std::unique_lock<std::mutex> lock(m_queueMutex);
+				m_queueSignal.wait(lock, [&] { return m_stopping || !m_queue.empty(); });
+				if (m_stopping)
+					return;
+				
+				job = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+			
+			RunPathJob(pathFinder, *job);
+		}
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "../API.hpp"
+#include "GridPathFinder.hpp"
+
+namespace jm
+{
+	namespace detail
+	{
+		struct PathRequestKey
+		{
+			glm::vec2 source;
+			glm::vec2 dest;
+			float maxLength;
+			uint32_t algorithm;
+			
+			bool operator==(const PathRequestKey& other) const;
+		};
+		
+		struct PathRequestKeyHash
+		{
+			size_t operator()(const PathRequestKey& key) const;
+		};
+		
+		struct PathJob
+		{
+			PathRequestKey key;
+			std::shared_ptr<const class TileSolidityMap> map;
+			
+			GridPathFinder::FindResult result;
+			std::vector<glm::vec2> path;
+			std::atomic_bool done { false };
+		};
+	}
+	
+	/***
+	 * Handle to a path requested from a PathService. Copies of the handle refer to the same request.
+	 */
+	class JAPI PathHandle
+	{
+	public:
+		PathHandle() = default;
+		
+		bool IsValid() const
+		{
+			return m_job != nullptr;
+		}
+		
+		bool IsDone() const
+		{
+			return m_job->done.load(std::memory_order_acquire);
+		}
+		
+		/***
+		 * Gets the result of the search. Must only be called once IsDone returns true.
+		 */
+		GridPathFinder::FindResult Result() const
+		{
+			return m_job->result;
+		}
+		
+		/***
+		 * Gets the path found by the search. Must only be called once IsDone returns true.
+		 */
+		const std::vector<glm::vec2>& Path() const
+		{
+			return m_job->path;
+		}
+		
+	private:
+		friend class PathService;
+		
+		explicit PathHandle(std::shared_ptr<detail::PathJob> job)
+			: m_job(std::move(job)) { }
+		
+		std::shared_ptr<detail::PathJob> m_job;
+	};
+	
+	/***
+	 * Runs path searches on a pool of worker threads, each with its own GridPathFinder.
+	 * Searches run against a snapshot of the map taken by SetMap, so the map can keep changing while they run.
+	 * Requests are collected until Dispatch is called, and identical requests against the same snapshot share one search.
+	 * Without threads (Emscripten), Dispatch runs the searches itself before returning.
+	 */
+	class JAPI PathService
+	{
+	public:
+		/***
+		 * @param numThreads The number of worker threads, or 0 to use one less than the number of hardware threads.
+		 *                   Ignored without threads.
+		 */
+		explicit PathService(uint32_t numThreads = 0);
+		
+		~PathService();
+		
+		PathService(const PathService& other) = delete;
+		PathService& operator=(const PathService& other) = delete;
+		
+		/***
+		 * Takes a snapshot of the map to use for requests made after this call.
+		 * Requests that have already been made keep using the previous snapshot.
+		 */
+		void SetMap(const class TileSolidityMap& map);
+		
+		/***
+		 * Requests a path. The search starts when Dispatch is called.
+		 * If an identical request has been made since the last call to SetMap and its handle is still held,
+		 * the returned handle refers to the same search.
+		 */
+		PathHandle Request(glm::vec2 source, glm::vec2 dest, float maxLength = INFINITY,
+			GridPathFinder::Algorithm algorithm = GridPathFinder::Algorithm::AStar);
+		
+		/***
+		 * Hands the requests made since the last call to the worker threads. Should be called once per frame.
+		 */
+		void Dispatch();
+		
+	private:
+		void WorkerMain();
+		
+		static void RunPathJob(GridPathFinder& pathFinder, detail::PathJob& job);
+		
+		std::shared_ptr<const class TileSolidityMap> m_map;
+		
+		std::unordered_map<detail::PathRequestKey, std::weak_ptr<detail::PathJob>, detail::PathRequestKeyHash> m_requests;
+		std::vector<std::shared_ptr<detail::PathJob>> m_undispatchedJobs;
+		
+		std::mutex m_queueMutex;
+		std::condition_variable m_queueSignal;
+		std::deque<std::shared_ptr<detail::PathJob>> m_queue;
+		bool m_stopping = false;
+		
+		std::vector<std::thread> m_threads;
+	};
+}
@@ -0,0 +1,77 @@
+#include "SpatialGrid.hpp"
+#include "TileSolidityMap.hpp"
+
+namespace jm
+{
+	SpatialGrid::SpatialGrid(uint32_t width, uint32_t height, float cellWidth, float cellHeight, glm::vec2 offset)
+		: m_cellWidth(cellWidth), m_cellHeight(cellHeight), m_offset(offset),
+		  m_width(std::max(width, 1U)), m_height(std::max(height, 1U)), m_cellStart(m_width * m_height + 1, 0) { }
+	
+	//The number of cells needed to cover a number of tiles, checked here since it runs before the constructor body
+	static uint32_t NumCellsForTiles(uint32_t numTiles, uint32_t tilesPerCell)
+	{
+		if (tilesPerCell == 0)
+			Panic("SpatialGrid created with 0 tiles per cell");
+		return (numTiles + tilesPerCell - 1) / tilesPerCell;
+	}
+	
+	SpatialGrid::SpatialGrid(const TileSolidityMap& solidityMap, uint32_t tilesPerCell)
+		: SpatialGrid(NumCellsForTiles(solidityMap.Width(), tilesPerCell),
+		              NumCellsForTiles(solidityMap.Height(), tilesPerCell),
+		              solidityMap.TileWidth() * tilesPerCell, solidityMap.TileHeight() * tilesPerCell,
+		              solidityMap.Offset()) { }
+	
+	void SpatialGrid::Clear()
+	{
+		m_items.clear();
+		m_cellItems.clear();
+		std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+	}
+	
+	void SpatialGrid::Add(Handle handle, const Rectangle& rectangle)
+	{
+		m_items.push_back({ handle, rectangle, ClampedCell(rectangle.Min()), ClampedCell(rectangle.Max()) });
+	}
+	
+	void SpatialGrid::Build()
+	{
+		//Counts the number of items in each cell, offset by one so that the prefix sum produces start indices
+		std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+		for (const Item& item : m_items)
+		{
+			for (int y = item.minCell.y; y <= item.maxCell.y; y++)
+			{
+				for (int x = item.minCell.x; x <= item.maxCell.x; x++)
+				{
+					m_cellStart[y * m_width + x + 1]++;
+				}
+			}
+		}
+		
+		for (size_t i = 1; i < m_cellStart.size(); i++)
+		{
+			m_cellStart[i] += m_cellStart[i - 1];
+		}
+		
+		//Writes item indices into their cells, using m_cellStart[i] as the write position for cell i
+		m_cellItems.resize(m_cellStart.back());
+		for (uint32_t itemIdx = 0; itemIdx < m_items.size(); itemIdx++)
+		{
+			const Item& item = m_items[itemIdx];
+			for (int y = item.minCell.y; y <= item.maxCell.y; y++)
+			{
+				for (int x = item.minCell.x; x <= item.maxCell.x; x++)
+				{
+					m_cellItems[m_cellStart[y * m_width + x]++] = itemIdx;
+				}
+			}
+		}
+		
+		//Writing shifted each start index to the next cell's start, so shift them back
+		for (size_t i = m_cellStart.size() - 1; i > 0; i--)
+		{
+			m_cellStart[i] = m_cellStart[i - 1];
+		}
+		m_cellStart[0] = 0;
+	}
+}
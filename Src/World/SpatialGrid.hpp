@@ -0,0 +1,218 @@
+#pragma once
+
+#include "../API.hpp"
+#include "../Rectangle.hpp"
+#include "GridTraversal.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+#include <glm/glm.hpp>
+
+namespace jm
+{
+	/***
+	 * Uniform grid for broad-phase queries against dynamic rectangles, such as entities.
+	 * The grid is rebuilt from scratch every frame: call Clear, Add each rectangle, then Build before querying.
+	 * Cells use the same conventions as TileSolidityMap (cell size and world offset), and rectangles
+	 * outside the grid are clamped to the edge cells.
+	 */
+	class JAPI SpatialGrid
+	{
+	public:
+		using Handle = uint32_t;
+		
+		struct Hit
+		{
+			Handle handle;
+			glm::vec2 point;
+			glm::vec2 normal;
+			float t;
+		};
+		
+		SpatialGrid(uint32_t width, uint32_t height, float cellWidth, float cellHeight,
+			glm::vec2 offset = glm::vec2(0));
+		
+		/***
+		 * Creates a grid covering the same area as a solidity map, with each cell spanning tilesPerCell² tiles.
+		 */
+		explicit SpatialGrid(const class TileSolidityMap& solidityMap, uint32_t tilesPerCell = 4);
+		
+		void Clear();
+		
+		void Add(Handle handle, const Rectangle& rectangle);
+		
+		/***
+		 * Sorts the added rectangles into cells, must be called after adding rectangles and before querying.
+		 */
+		void Build();
+		
+		/***
+		 * Invokes callback(Handle, const Rectangle&) once for each rectangle intersecting the region.
+		 */
+		template <typename CallbackTp>
+		void QueryRegion(const Rectangle& region, CallbackTp callback) const
+		{
+			const glm::ivec2 regionMin = ClampedCell(region.Min());
+			const glm::ivec2 regionMax = ClampedCell(region.Max());
+			
+			for (int y = regionMin.y; y <= regionMax.y; y++)
+			{
+				for (int x = regionMin.x; x <= regionMax.x; x++)
+				{
+					const uint32_t cellIdx = y * m_width + x;
+					for (uint32_t i = m_cellStart[cellIdx]; i < m_cellStart[cellIdx + 1]; i++)
+					{
+						const Item& item = m_items[m_cellItems[i]];
+						
+						//Rectangles spanning several cells are only reported from the first cell shared with the region
+						if (x != std::max(item.minCell.x, regionMin.x) || y != std::max(item.minCell.y, regionMin.y))
+							continue;
+						
+						if (item.rectangle.Intersects(region))
+							callback(item.handle, item.rectangle);
+					}
+				}
+			}
+		}
+		
+		/***
+		 * Invokes callback(Handle, Handle) once for each pair of intersecting rectangles.
+		 */
+		template <typename CallbackTp>
+		void IteratePairs(CallbackTp callback) const
+		{
+			for (uint32_t cellIdx = 0; cellIdx < m_width * m_height; cellIdx++)
+			{
+				const glm::ivec2 cell(cellIdx % m_width, cellIdx / m_width);
+				const uint32_t end = m_cellStart[cellIdx + 1];
+				for (uint32_t i = m_cellStart[cellIdx]; i < end; i++)
+				{
+					const Item& a = m_items[m_cellItems[i]];
+					for (uint32_t j = i + 1; j < end; j++)
+					{
+						const Item& b = m_items[m_cellItems[j]];
+						
+						//Pairs sharing several cells are only reported from the first shared cell
+						if (cell.x != std::max(a.minCell.x, b.minCell.x) || cell.y != std::max(a.minCell.y, b.minCell.y))
+							continue;
+						
+						if (a.rectangle.Intersects(b.rectangle))
+							callback(a.handle, b.handle);
+					}
+				}
+			}
+		}
+		
+		std::optional<Hit> Raycast(glm::vec2 start, glm::vec2 end) const
+		{
+			return Raycast(start, end, [] (Handle) { return true; });
+		}
+		
+		/***
+		 * Finds the first rectangle hit by a line segment.
+		 * @param filter Callback bool(Handle), rectangles are only considered if it returns true.
+		 */
+		template <typename FilterTp>
+		std::optional<Hit> Raycast(glm::vec2 start, glm::vec2 end, FilterTp filter) const
+		{
+			const glm::vec2 dir = end - start;
+			
+			std::optional<Hit> hit;
+			glm::ivec2 prevCell(-1);
+			detail::TraverseGridLine(ToLocal(start), ToLocal(end), [&] (glm::ivec2 cell, float tEnter, glm::vec2)
+			{
+				//Cells further along the line can't contain a closer hit
+				if (hit.has_value() && tEnter > hit->t)
+					return true;
+				
+				//Rectangles outside the grid are stored in the edge cells, so cells outside are clamped as well
+				cell = ClampCell(cell);
+				if (cell == prevCell)
+					return false;
+				prevCell = cell;
+				
+				const uint32_t cellIdx = cell.y * m_width + cell.x;
+				for (uint32_t i = m_cellStart[cellIdx]; i < m_cellStart[cellIdx + 1]; i++)
+				{
+					const Item& item = m_items[m_cellItems[i]];
+					
+					float tNear;
+					glm::vec2 normal;
+					if (item.rectangle.IntersectsRay(start, dir, tNear, normal) && filter(item.handle))
+					{
+						const float t = std::max(tNear, 0.0f);
+						if (!hit.has_value() || t < hit->t)
+							hit = Hit { item.handle, start + dir * t, normal, t };
+					}
+				}
+				return false;
+			});
+			return hit;
+		}
+		
+		bool InRange(int x, int y) const
+		{
+			return x >= 0 && y >= 0 && x < (int)m_width && y < (int)m_height;
+		}
+		
+		uint32_t Width() const
+		{ return m_width; }
+		
+		uint32_t Height() const
+		{ return m_height; }
+		
+		size_t NumItems() const
+		{ return m_items.size(); }
+		
+		float ToLocalX(float v) const { return (v - m_offset.x) / m_cellWidth; }
+		float ToLocalY(float v) const { return (v - m_offset.y) / m_cellHeight; }
+		glm::vec2 ToLocal(glm::vec2 v) const { return (v - m_offset) / glm::vec2(m_cellWidth, m_cellHeight); };
+		
+		float CellWidth() const
+		{
+			return m_cellWidth;
+		}
+		
+		float CellHeight() const
+		{
+			return m_cellHeight;
+		}
+		
+		glm::vec2 Offset() const
+		{
+			return m_offset;
+		}
+		
+	private:
+		glm::ivec2 ClampCell(glm::ivec2 cell) const
+		{
+			return glm::clamp(cell, glm::ivec2(0), glm::ivec2((int)m_width - 1, (int)m_height - 1));
+		}
+		
+		glm::ivec2 ClampedCell(glm::vec2 pos) const
+		{
+			return ClampCell(glm::ivec2(glm::floor(ToLocal(pos))));
+		}
+		
+		struct Item
+		{
+			Handle handle;
+			Rectangle rectangle;
+			glm::ivec2 minCell;
+			glm::ivec2 maxCell;
+		};
+		
+		float m_cellWidth;
+		float m_cellHeight;
+		glm::vec2 m_offset;
+		uint32_t m_width;
+		uint32_t m_height;
+		
+		std::vector<Item> m_items;
+		
+		//Items in cell i are m_cellItems[m_cellStart[i]] to m_cellItems[m_cellStart[i + 1] - 1]
+		std::vector<uint32_t> m_cellStart;
+		std::vector<uint32_t> m_cellItems;
+	};
+}
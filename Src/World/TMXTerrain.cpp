@@ -1,5 +1,6 @@
 #include "TMXTerrain.hpp"
 #include "TileSolidityMap.hpp"
+#include "TileCostMap.hpp"
 #include "../Asset.hpp"
 
 #include <tinyxml2.h>
@@ -151,11 +152,11 @@ namespace jm
 		terrain.m_tileHeight = mapElement.IntAttribute("tileheight", 1);
 		
 		//Loads tile sets
-		std::vector<std::pair<int, const TileSet*>> tileSetsByFirstGId;
+		std::vector<GIDTableEntry> tileSetsByFirstGID;
 		for (auto tileSetEl = mapElement.FirstChildElement("tileset"); tileSetEl; tileSetEl = tileSetEl->NextSiblingElement("tileset"))
 		{
-			int firstGId;
-			if (tileSetEl->QueryIntAttribute("firstgid", &firstGId))
+			uint32_t firstGID;
+			if (tileSetEl->QueryUnsignedAttribute("firstgid", &firstGID))
 				FormatError("Missing 'firstgid'");
 			
 			const TileSet* tileSet;
@@ -171,9 +172,10 @@ namespace jm
 				tileSet = &GetAsset<TileSet>(fullSourceName);
 			}
 			
-			tileSetsByFirstGId.emplace_back(firstGId, tileSet);
+			tileSetsByFirstGID.push_back({ firstGID, tileSet });
 		}
-		std::sort(tileSetsByFirstGId.begin(), tileSetsByFirstGId.end());
+		std::sort(tileSetsByFirstGID.begin(), tileSetsByFirstGID.end(),
+			[&] (const GIDTableEntry& a, const GIDTableEntry& b) { return a.firstGID < b.firstGID; });
 		
 		//Loads layers
 		for (auto el = mapElement.FirstChildElement(); el; el = el->NextSiblingElement())
@@ -218,43 +220,10 @@ namespace jm
 				
 				//TODO: Decompress data
 				
-				const uint32_t* tilePtr = reinterpret_cast<uint32_t*>(data.data());
+				gsl::span<const uint32_t> gids(reinterpret_cast<const uint32_t*>(data.data()), data.size() / sizeof(uint32_t));
 				
 				layer.tileMap = TileMap(terrain.m_mapWidth, terrain.m_mapHeight);
-				for (int y = terrain.m_mapHeight - 1; y >= 0; y--)
-				{
-					for (int x = 0; x < terrain.m_mapWidth; x++, tilePtr++)
-					{
-						static constexpr uint32_t FLIPPED_HORIZONTALLY_FLAG = 0x80000000;
-						static constexpr uint32_t FLIPPED_VERTICALLY_FLAG   = 0x40000000;
-						static constexpr uint32_t FLIPPED_DIAGONALLY_FLAG   = 0x20000000;
-						
-						uint32_t maskedId = *tilePtr & ~(FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG);
-						
-						uint32_t firstGid;
-						const TileSet* tileSet = nullptr;
-						for (auto& tileSetPair : tileSetsByFirstGId)
-						{
-							if (tileSetPair.first > maskedId)
-								break;
-							firstGid = tileSetPair.first;
-							tileSet = tileSetPair.second;
-						}
-						
-						if (tileSet == nullptr)
-							continue;
-						
-						TileFlags tileFlags = TileFlags::None;
-						if (*tilePtr & FLIPPED_HORIZONTALLY_FLAG)
-							tileFlags |= TileFlags::FlippedX;
-						if (*tilePtr & FLIPPED_VERTICALLY_FLAG)
-							tileFlags |= TileFlags::FlippedY;
-						if (*tilePtr & FLIPPED_DIAGONALLY_FLAG)
-							tileFlags |= TileFlags::FlippedDiag;
-						
-						layer.tileMap->SetTile(x, y, *tileSet, maskedId - firstGid, tileFlags);
-					}
-				}
+				layer.tileMap->ImportGIDs(gids, tileSetsByFirstGID);
 			}
 			else if (isObjectLayer)
 			{
@@ -331,6 +300,19 @@ namespace jm
 		return solidityMap;
 	}
 	
+	TileCostMap TMXTerrain::MakeCostMap(uint32_t dataMask) const
+	{
+		TileCostMap costMap(m_mapWidth, m_mapHeight);
+		for (const TMXLayer& layer : m_layers)
+		{
+			if (layer.tileMap.has_value())
+			{
+				costMap.Apply(*layer.tileMap, dataMask);
+			}
+		}
+		return costMap;
+	}
+	
 	TMXLayer* TMXTerrain::GetLayerByName(std::string_view name)
 	{
 		for (TMXLayer& layer : m_layers)
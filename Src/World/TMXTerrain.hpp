@@ -64,6 +64,7 @@ namespace jm
 		glm::ivec2 TileSize() const { return glm::ivec2(m_tileWidth, m_tileHeight); }
 		
 		class TileSolidityMap MakeSolidityMap(uint32_t dataMask) const;
+		class TileCostMap MakeCostMap(uint32_t dataMask) const;
 		
 		const TMXShape* GetShapeByName(std::string_view name) const
 		{
@@ -0,0 +1,102 @@
+#include "TileCostMap.hpp"
+#include "TileSolidityMap.hpp"
+#include "TileMap.hpp"
+
+#include <iterator>
+
+namespace jm
+{
+	//Same order as the directions in GridPathFinder.
+	static const glm::ivec2 moveOffsets[] =
+	{
+		glm::ivec2(-1,  0),
+		glm::ivec2( 1,  0),
+		glm::ivec2( 0, -1),
+		glm::ivec2( 0,  1),
+		glm::ivec2(-1,  1),
+		glm::ivec2( 1,  1),
+		glm::ivec2( 1, -1),
+		glm::ivec2(-1, -1)
+	};
+	
+	TileCostMap::TileCostMap(uint32_t width, uint32_t height)
+		: m_width(width), m_height(height), m_cells(width * height, Cell { DEFAULT_COST, 0 }) { }
+	
+	void TileCostMap::Apply(const TileMap& tileMap, uint32_t dataMask, glm::ivec2 dstOffset)
+	{
+		if (dataMask == 0)
+			return;
+		uint32_t shift = 0;
+		while (((dataMask >> shift) & 1U) == 0)
+			shift++;
+		
+		for (uint32_t y = 0; y < tileMap.Height(); y++)
+		{
+			for (uint32_t x = 0; x < tileMap.Width(); x++)
+			{
+				glm::ivec2 dst = glm::ivec2(x, y) + dstOffset;
+				if (InRange(dst.x, dst.y))
+				{
+					auto [tileSet, tileId, tileFlags] = tileMap.GetTile(x, y);
+					
+					if (tileSet != nullptr)
+					{
+						const uint32_t cost = (tileSet->GetTile(tileId).data & dataMask) >> shift;
+						if (cost != 0)
+							SetCostUnchecked(dst.x, dst.y, (uint8_t)std::min(cost, (uint32_t)UINT8_MAX));
+					}
+				}
+			}
+		}
+	}
+	
+	void TileCostMap::UpdateMoves(const TileSolidityMap& map) const
+	{
+		if (map.Width() != m_width || map.Height() != m_height)
+			Panic("TileCostMap::UpdateMoves called with a map of a different size");
+		
+		if (m_movesMapID != map.ID())
+		{
+			UpdateMovesInRegion(map, 0, 0, m_width, m_height);
+		}
+		else if (map.Version() != m_movesVersion)
+		{
+			//The moves from a tile depend on the tiles around it, so blocks are also recomputed if tiles next to them changed
+			constexpr int B = TileSolidityMap::VERSION_BLOCK_SIZE;
+			for (int y = 0; y < (int)m_height; y += B)
+			{
+				for (int x = 0; x < (int)m_width; x += B)
+				{
+					if (map.RegionChangedSince(x - 1, y - 1, B + 2, B + 2, m_movesVersion))
+					{
+						UpdateMovesInRegion(map, x, y, std::min(x + B, (int)m_width), std::min(y + B, (int)m_height));
+					}
+				}
+			}
+		}
+		
+		m_movesMapID = map.ID();
+		m_movesVersion = map.Version();
+	}
+	
+	void TileCostMap::UpdateMovesInRegion(const TileSolidityMap& map, int beginX, int beginY, int endX, int endY) const
+	{
+		auto IsFree = [&] (int x, int y) { return map.InRange(x, y) && !map.IsSolidUnchecked(x, y); };
+		
+		for (int y = beginY; y < endY; y++)
+		{
+			for (int x = beginX; x < endX; x++)
+			{
+				//Diagonal moves can't cut corners, so both tiles beside the move must be free as well
+				uint8_t moves = 0;
+				for (uint32_t dir = 0; dir < std::size(moveOffsets); dir++)
+				{
+					const glm::ivec2 n = glm::ivec2(x, y) + moveOffsets[dir];
+					if (IsFree(n.x, n.y) && IsFree(x, n.y) && IsFree(n.x, y))
+						moves |= (uint8_t)(1U << dir);
+				}
+				m_cells[y * m_width + x].moves = moves;
+			}
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../API.hpp"
+#include "../Utils.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace jm
+{
+	/***
+	 * Movement costs for the tiles of a TileSolidityMap, used by GridPathFinder to prefer some tiles over others.
+	 * The cost of a tile multiplies the distance moved when entering it, so it must be at least 1.
+	 */
+	class JAPI TileCostMap
+	{
+	public:
+		static constexpr uint8_t DEFAULT_COST = 1;
+		
+		struct Cell
+		{
+			uint8_t cost;
+			
+			//Bit i is set if the tile can be left towards its i'th neighbor, in the same order as the directions
+			// used by GridPathFinder. Kept next to the cost so that searches only read one array.
+			uint8_t moves;
+		};
+		
+		TileCostMap(uint32_t width, uint32_t height);
+		
+		/***
+		 * Sets the cost of the tiles whose data has any bits in dataMask set to those bits, shifted down
+		 * to the lowest bit of the mask. Tiles without any of the bits set keep their cost.
+		 */
+		void Apply(const class TileMap& tileMap, uint32_t dataMask, glm::ivec2 dstOffset = { });
+		
+		void SetCost(int x, int y, uint8_t cost)
+		{
+			if (!InRange(x, y))
+				Panic("TileCostMap::SetCost out of range");
+			SetCostUnchecked(x, y, cost);
+		}
+		
+		void SetCostUnchecked(int x, int y, uint8_t cost)
+		{
+			m_cells[y * m_width + x].cost = std::max(cost, (uint8_t)1);
+		}
+		
+		uint8_t Cost(int x, int y) const
+		{
+			return m_cells[y * m_width + x].cost;
+		}
+		
+		/***
+		 * Brings the move bits up to date with the solidity of the tiles in a map of the same size.
+		 * Only blocks of tiles that changed since the last update are recomputed, maps are told apart by TileSolidityMap::ID.
+		 * This is called by GridPathFinder, but must be called beforehand if searches using the same cost map
+		 * run concurrently.
+		 */
+		void UpdateMoves(const class TileSolidityMap& map) const;
+		
+		const Cell& GetCellUnchecked(int x, int y) const
+		{
+			return m_cells[y * m_width + x];
+		}
+		
+		bool InRange(int x, int y) const
+		{
+			return x >= 0 && y >= 0 && x < (int)m_width && y < (int)m_height;
+		}
+		
+		uint32_t Width() const
+		{ return m_width; }
+		
+		uint32_t Height() const
+		{ return m_height; }
+		
+	private:
+		void UpdateMovesInRegion(const class TileSolidityMap& map, int beginX, int beginY, int endX, int endY) const;
+		
+		uint32_t m_width;
+		uint32_t m_height;
+		
+		//Only the move bits are written by UpdateMoves.
+		mutable std::vector<Cell> m_cells;
+		
+		//The id and version of the map when the move bits were last updated, all bits are recomputed for a different map.
+		mutable uint64_t m_movesMapID = 0;
+		mutable uint64_t m_movesVersion = 0;
+	};
+}
@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 namespace jm
 {
@@ -29,33 +30,160 @@ namespace jm
 		m_vertexLayout.InitAttribute(1, 0, DataType::Float32, 2, offsetof(TileMapVertex, texCoord));
 	}
 	
+	uint32_t TileMap::GetTileSetIndex(const TileSet& tileSet)
+	{
+		for (size_t i = 0; i < m_tileSets.size(); i++)
+		{
+			if (m_tileSets[i].tileSet == &tileSet)
+				return i;
+		}
+		
+		if (m_tileSets.size() == 254)
+		{
+			std::cerr << "Too many tilesets, max is 254\n";
+			std::abort();
+		}
+		
+		m_tileSets.push_back({ 0, 0, &tileSet });
+		return m_tileSets.size() - 1;
+	}
+	
+	void TileMap::CheckRegion(int x, int y, uint32_t width, uint32_t height, const char* funcName) const
+	{
+		//Compared without adding so that large sizes can't wrap around
+		if (x < 0 || y < 0 || (uint32_t)x > m_width || (uint32_t)y > m_height ||
+		    width > m_width - (uint32_t)x || height > m_height - (uint32_t)y)
+		{
+			Panic(Concat({ "TileMap::", funcName, " out of range" }));
+		}
+	}
+	
 	void TileMap::SetTile(int x, int y, const jm::TileSet& tileSet, jm::TileID tileID, TileFlags flags)
 	{
 		if (!InRange(x, y))
 			Panic("TileMap::GetTile out of range");
 		
-		size_t tileSetIdx = m_tileSets.size();
-		for (size_t i = 0; i < m_tileSets.size(); i++)
+		m_tileData[x + y * m_width] = PackTile(GetTileSetIndex(tileSet), tileID, flags);
+		m_outOfDate = true;
+	}
+	
+	void TileMap::SetTiles(int x, int y, uint32_t width, uint32_t height, gsl::span<const TileID> tileIDs,
+		const TileSet& tileSet, TileFlags flags)
+	{
+		CheckRegion(x, y, width, height, "SetTiles");
+		if ((size_t)tileIDs.size() != (size_t)width * height)
+			Panic("TileMap::SetTiles tile id count does not match the region size");
+		
+		const uint32_t baseValue = PackTile(GetTileSetIndex(tileSet), 0, flags);
+		const TileID* srcPtr = tileIDs.data();
+		for (uint32_t dy = 0; dy < height; dy++)
 		{
-			if (m_tileSets[i].tileSet == &tileSet)
+			uint32_t* dstPtr = &m_tileData[x + (y + dy) * m_width];
+			for (uint32_t dx = 0; dx < width; dx++)
 			{
-				tileSetIdx = i;
-				break;
+				dstPtr[dx] = baseValue | (srcPtr[dx] << 11U);
 			}
+			srcPtr += width;
+		}
+		
+		m_outOfDate |= width != 0 && height != 0;
+	}
+	
+	void TileMap::Fill(int x, int y, uint32_t width, uint32_t height, const TileSet& tileSet, TileID tileID, TileFlags flags)
+	{
+		CheckRegion(x, y, width, height, "Fill");
+		
+		const uint32_t value = PackTile(GetTileSetIndex(tileSet), tileID, flags);
+		for (uint32_t dy = 0; dy < height; dy++)
+		{
+			std::fill_n(&m_tileData[x + (y + dy) * m_width], width, value);
 		}
 		
-		if (tileSetIdx == m_tileSets.size())
+		m_outOfDate |= width != 0 && height != 0;
+	}
+	
+	void TileMap::Clear(int x, int y, uint32_t width, uint32_t height)
+	{
+		CheckRegion(x, y, width, height, "Clear");
+		
+		for (uint32_t dy = 0; dy < height; dy++)
 		{
-			if (m_tileSets.size() == 254)
+			std::fill_n(&m_tileData[x + (y + dy) * m_width], width, 0U);
+		}
+		
+		m_outOfDate |= width != 0 && height != 0;
+	}
+	
+	void TileMap::ImportGIDs(gsl::span<const uint32_t> gids, gsl::span<const GIDTableEntry> gidTable)
+	{
+		static constexpr uint32_t FLIPPED_HORIZONTALLY_FLAG = 0x80000000;
+		static constexpr uint32_t FLIPPED_VERTICALLY_FLAG   = 0x40000000;
+		static constexpr uint32_t FLIPPED_DIAGONALLY_FLAG   = 0x20000000;
+		static constexpr uint32_t FLIP_MASK = FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG;
+		
+		if (m_width == 0 || m_height == 0)
+			return;
+		
+		//Tile set index + 1 for each entry in the gid table, resolved the first time the entry is used
+		std::vector<uint32_t> tileSetValues(gidTable.size(), 0);
+		
+		//The range of global ids covered by the most recently used table entry, lookups are usually repeated.
+		uint32_t rangeBegin = 1;
+		uint32_t rangeEnd = 0;
+		uint32_t rangeFirstGID = 0;
+		uint32_t rangeTileSetValue = 0;
+		
+		const size_t numTiles = std::min((size_t)gids.size(), (size_t)m_width * m_height);
+		uint32_t* dstRow = &m_tileData[(m_height - 1) * m_width];
+		uint32_t x = 0;
+		for (size_t i = 0; i < numTiles; i++)
+		{
+			const uint32_t gid = gids[i];
+			const uint32_t maskedId = gid & ~FLIP_MASK;
+			
+			if (maskedId < rangeBegin || maskedId >= rangeEnd)
 			{
-				std::cerr << "Too many tilesets, max is 254\n";
-				std::abort();
+				auto it = std::upper_bound(gidTable.begin(), gidTable.end(), maskedId,
+					[] (uint32_t id, const GIDTableEntry& entry) { return id < entry.firstGID; });
+				if (it == gidTable.begin())
+				{
+					rangeBegin = 0;
+					rangeEnd = gidTable.empty() ? UINT32_MAX : gidTable[0].firstGID;
+					rangeFirstGID = 0;
+					rangeTileSetValue = 0;
+				}
+				else
+				{
+					const size_t entryIdx = (it - gidTable.begin()) - 1;
+					rangeBegin = gidTable[entryIdx].firstGID;
+					rangeEnd = it == gidTable.end() ? UINT32_MAX : it->firstGID;
+					rangeFirstGID = rangeBegin;
+					
+					if (tileSetValues[entryIdx] == 0)
+						tileSetValues[entryIdx] = GetTileSetIndex(*gidTable[entryIdx].tileSet) + 1;
+					rangeTileSetValue = tileSetValues[entryIdx];
+				}
 			}
 			
-			m_tileSets.push_back({ 0, 0, &tileSet });
+			uint32_t flags = 0;
+			if (gid & FLIPPED_HORIZONTALLY_FLAG)
+				flags |= (uint32_t)TileFlags::FlippedX;
+			if (gid & FLIPPED_VERTICALLY_FLAG)
+				flags |= (uint32_t)TileFlags::FlippedY;
+			if (gid & FLIPPED_DIAGONALLY_FLAG)
+				flags |= (uint32_t)TileFlags::FlippedDiag;
+			
+			dstRow[x] = rangeTileSetValue == 0 ? 0 :
+				(rangeTileSetValue | (flags << 8U) | ((maskedId - rangeFirstGID) << 11U));
+			
+			//Tiled stores the top row first, while tile maps have y pointing up
+			if (++x == m_width)
+			{
+				x = 0;
+				dstRow -= m_width;
+			}
 		}
 		
-		m_tileData[x + y * m_width] = (tileSetIdx + 1) | ((uint32_t)flags << 8U) | (tileID << 11U);
 		m_outOfDate = true;
 	}
 	
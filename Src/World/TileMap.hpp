@@ -9,6 +9,7 @@
 #include <tuple>
 #include <memory>
 #include <cstdint>
+#include <gsl/span>
 
 namespace jm
 {
@@ -21,6 +22,15 @@ namespace jm
 	};
 	JM_BIT_FIELD(TileFlags)
 	
+	/***
+	 * Maps a range of Tiled global tile ids (starting at firstGID) to a tile set.
+	 */
+	struct GIDTableEntry
+	{
+		uint32_t firstGID;
+		const TileSet* tileSet;
+	};
+	
 	class JAPI TileMap
 	{
 	public:
@@ -28,6 +38,32 @@ namespace jm
 		
 		void SetTile(int x, int y, const TileSet& tileSet, TileID tileID, TileFlags flags = TileFlags::None);
 		
+		/***
+		 * Sets all tiles in a rectangular region.
+		 * @param tileIDs Tile ids for the region in row-major order, must contain width * height entries.
+		 */
+		void SetTiles(int x, int y, uint32_t width, uint32_t height, gsl::span<const TileID> tileIDs,
+			const TileSet& tileSet, TileFlags flags = TileFlags::None);
+		
+		/***
+		 * Sets all tiles in a rectangular region to the same tile.
+		 */
+		void Fill(int x, int y, uint32_t width, uint32_t height, const TileSet& tileSet, TileID tileID,
+			TileFlags flags = TileFlags::None);
+		
+		/***
+		 * Sets all tiles in a rectangular region to empty.
+		 */
+		void Clear(int x, int y, uint32_t width, uint32_t height);
+		
+		/***
+		 * Replaces the contents of the map with Tiled global tile ids, including Tiled's flip bits.
+		 * @param gids Global tile ids in row-major order, starting with the top row (as stored by Tiled).
+		 *             Tiles past the end of gids are left unchanged.
+		 * @param gidTable Tile sets sorted by first global id. Ids not covered by any tile set become empty.
+		 */
+		void ImportGIDs(gsl::span<const uint32_t> gids, gsl::span<const GIDTableEntry> gidTable);
+		
 		std::tuple<const TileSet*, TileID, TileFlags> GetTile(int x, int y) const;
 		
 		bool InRange(int x, int y) const
@@ -50,6 +86,15 @@ namespace jm
 		static const char* DefaultVertexShader;
 		
 	private:
+		uint32_t GetTileSetIndex(const TileSet& tileSet);
+		
+		void CheckRegion(int x, int y, uint32_t width, uint32_t height, const char* funcName) const;
+		
+		static uint32_t PackTile(uint32_t tileSetIdx, TileID tileID, TileFlags flags)
+		{
+			return (tileSetIdx + 1) | ((uint32_t)flags << 8U) | (tileID << 11U);
+		}
+		
 		uint32_t m_width;
 		uint32_t m_height;
 		
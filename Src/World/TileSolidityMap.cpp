@@ -1,24 +1,28 @@
 #include "TileSolidityMap.hpp"
 #include "TileMap.hpp"
+#include "GridTraversal.hpp"
 #include "../Graphics/Graphics2D.hpp"
 
 #include <queue>
+#include <atomic>
+#include <future>
+#include <utility>
 
 namespace jm
 {
-	TileSolidityMap::TileSolidityMap(uint32_t width, uint32_t height, float tileWidth, float tileHeight, glm::vec2 offset)
-		: m_tileWidth(tileWidth), m_tileHeight(tileHeight), m_offset(offset),
-		  m_width(width), m_height(height), m_isSolid(width * height, false), m_hitboxes(width * height)
+	uint64_t detail::NextTileSolidityMapID()
 	{
-		for (uint32_t y = 0; y < height; y++)
-		{
-			for (uint32_t x = 0; x < width; x++)
-			{
-				m_hitboxes[y * width + x] = Rectangle(x * tileWidth + offset.x, y * tileHeight + offset.y, tileWidth, tileHeight);
-			}
-		}
+		static std::atomic<uint64_t> nextID { 1 };
+		return nextID.fetch_add(1, std::memory_order_relaxed);
 	}
 	
+	TileSolidityMap::TileSolidityMap(uint32_t width, uint32_t height, float tileWidth, float tileHeight, glm::vec2 offset)
+		: m_tileWidth(tileWidth), m_tileHeight(tileHeight), m_offset(offset),
+		  m_width(width), m_height(height), m_wordsPerRow((width + 63) / 64),
+		  m_isSolid(m_wordsPerRow * height, 0), m_hasCustomHitbox(m_wordsPerRow * height, 0),
+		  m_versionBlocksPerRow((width + VERSION_BLOCK_SIZE - 1) / VERSION_BLOCK_SIZE),
+		  m_blockVersions(m_versionBlocksPerRow * ((height + VERSION_BLOCK_SIZE - 1) / VERSION_BLOCK_SIZE), 0) { }
+	
 	void TileSolidityMap::Apply(const TileMap& tileMap, uint32_t dataMask, glm::ivec2 dstOffset)
 	{
 		for (uint32_t y = 0; y < tileMap.Height(); y++)
@@ -35,13 +39,28 @@ namespace jm
 						const Tile& tile = tileSet->GetTile(tileId);
 						if (tile.data & dataMask)
 						{
-							SetIsSolid(dst.x, dst.y, true);
-							m_hitboxes[dst.y * m_width + dst.x] = jm::Rectangle(
-								((float)dst.x + tile.hitbox.x / (float)tileSet->TileWidth()) * m_tileWidth + m_offset.x,
-								((float)dst.y + tile.hitbox.y / (float)tileSet->TileHeight()) * m_tileHeight + m_offset.y,
-								(m_tileWidth * tile.hitbox.w) / (float)tileSet->TileWidth(),
-								(m_tileHeight * tile.hitbox.h) / (float)tileSet->TileHeight()
-							);
+							SetIsSolidUnchecked(dst.x, dst.y, true);
+							
+							const uint32_t cellIdx = dst.y * m_width + dst.x;
+							const uint64_t cellMask = (uint64_t)1 << (dst.x % 64);
+							uint64_t& hasCustomWord = m_hasCustomHitbox[dst.y * m_wordsPerRow + dst.x / 64];
+							
+							if (tile.hitbox.x == 0 && tile.hitbox.y == 0 &&
+							    tile.hitbox.w == (float)tileSet->TileWidth() && tile.hitbox.h == (float)tileSet->TileHeight())
+							{
+								hasCustomWord &= ~cellMask;
+								m_customHitboxes.erase(cellIdx);
+							}
+							else
+							{
+								hasCustomWord |= cellMask;
+								m_customHitboxes[cellIdx] = jm::Rectangle(
+									((float)dst.x + tile.hitbox.x / (float)tileSet->TileWidth()) * m_tileWidth + m_offset.x,
+									((float)dst.y + tile.hitbox.y / (float)tileSet->TileHeight()) * m_tileHeight + m_offset.y,
+									(m_tileWidth * tile.hitbox.w) / (float)tileSet->TileWidth(),
+									(m_tileHeight * tile.hitbox.h) / (float)tileSet->TileHeight()
+								);
+							}
 						}
 					}
 				}
@@ -49,58 +68,139 @@ namespace jm
 		}
 	}
 	
+	Rectangle TileSolidityMap::GetHitbox(int x, int y) const
+	{
+		if ((m_hasCustomHitbox[y * m_wordsPerRow + x / 64] >> (x % 64)) & 1)
+		{
+			return m_customHitboxes.at(y * m_width + x);
+		}
+		return Rectangle(x * m_tileWidth + m_offset.x, y * m_tileHeight + m_offset.y, m_tileWidth, m_tileHeight);
+	}
+	
+	/***
+	 * Invokes a callback for the x coordinate of each solid tile in [beginX, endX) on row y.
+	 * Iteration stops early if the callback returns true.
+	 * @return Whether the callback stopped the iteration.
+	 */
+	template <typename CallbackTp>
+	bool TileSolidityMap::IterateSolidInRow(int y, int beginX, int endX, CallbackTp callback) const
+	{
+		if (y < 0 || y >= (int)m_height)
+			return false;
+		beginX = std::max(beginX, 0);
+		endX = std::min(endX, (int)m_width);
+		if (beginX >= endX)
+			return false;
+		
+		const uint64_t* row = &m_isSolid[y * m_wordsPerRow];
+		const int lastWord = (endX - 1) / 64;
+		for (int w = beginX / 64; w <= lastWord; w++)
+		{
+			uint64_t bits = row[w];
+			if (w == beginX / 64)
+				bits &= ~(uint64_t)0 << (beginX % 64);
+			if (w == lastWord && endX % 64 != 0)
+				bits &= ~(~(uint64_t)0 << (endX % 64));
+			
+			while (bits != 0)
+			{
+				if (callback(w * 64 + CountTrailingZeros64(bits)))
+					return true;
+				bits &= bits - 1;
+			}
+		}
+		
+		return false;
+	}
+	
 	bool TileSolidityMap::IntersectsSolid(const Rectangle& source) const
 	{
 		glm::vec2 min = ToLocal(source.Min());
 		glm::vec2 max = ToLocal(source.Max());
 		
+		const int minX = std::floor(min.x);
 		const int maxX = std::ceil(max.x);
 		const int maxY = std::ceil(max.y);
 		for (int y = std::floor(min.y); y < maxY; y++)
 		{
-			for (int x = std::floor(min.x); x < maxX; x++)
+			bool intersects = IterateSolidInRow(y, minX, maxX, [&] (int x)
 			{
-				if (IsSolid(x, y) && source.Intersects(m_hitboxes[y * m_width + x]))
-				{
-					return true;
-				}
-			}
+				return source.Intersects(GetHitbox(x, y));
+			});
+			
+			if (intersects)
+				return true;
 		}
 		return false;
 	}
 	
 	bool TileSolidityMap::LineIntersectsSolid(glm::vec2 start, glm::vec2 end) const
 	{
-		start = ToLocal(start);
-		end = ToLocal(end);
+		bool intersects = false;
+		detail::TraverseGridLine(ToLocal(start), ToLocal(end), [&] (glm::ivec2 cell, float t, glm::vec2 normal)
+		{
+			intersects = IsSolid(cell.x, cell.y);
+			return intersects;
+		});
+		return intersects;
+	}
+	
+	std::optional<RayHit> TileSolidityMap::Raycast(glm::vec2 start, glm::vec2 end) const
+	{
+		const glm::vec2 dir = end - start;
 		
-		float len = glm::distance(start, end);
-		if (len > 0.01f)
+		std::optional<RayHit> hit;
+		detail::TraverseGridLine(ToLocal(start), ToLocal(end), [&] (glm::ivec2 cell, float tEnter, glm::vec2 enterNormal)
 		{
-			glm::vec2 dir = (end - start) / len;
+			if (!IsSolid(cell.x, cell.y))
+				return false;
 			
-			float a = 0;
-			while (a < len)
+			float tNear;
+			glm::vec2 normal;
+			if (!GetHitbox(cell.x, cell.y).IntersectsRay(start, dir, tNear, normal))
+				return false;
+			
+			//Tiles are visited in order along the line, so the first hit is the closest one
+			const float t = std::max(tNear, 0.0f);
+			hit = RayHit { start + dir * t, normal, cell, t };
+			return true;
+		});
+		return hit;
+	}
+	
+	std::optional<RayHit> TileSolidityMap::Sweep(const Rectangle& rectangle, glm::vec2 move) const
+	{
+		const glm::vec2 localMin = ToLocal(glm::min(rectangle.Min(), rectangle.Min() + move));
+		const glm::vec2 localMax = ToLocal(glm::max(rectangle.Max(), rectangle.Max() + move));
+		
+		const int minX = (int)std::floor(localMin.x);
+		const int maxX = (int)std::ceil(localMax.x);
+		const int maxY = (int)std::ceil(localMax.y);
+		
+		std::optional<RayHit> hit;
+		for (int y = (int)std::floor(localMin.y); y < maxY; y++)
+		{
+			IterateSolidInRow(y, minX, maxX, [&] (int x)
 			{
-				glm::vec2 pos = start + dir * a;
-				assert(InRange(std::floor(pos.x), std::floor(pos.y)));
-				if (IsSolid(std::floor(pos.x), std::floor(pos.y)))
-					return true;
+				//Sweeping the rectangle against a hitbox is the same as casting a ray from the rectangle's
+				// minimum corner against the hitbox extended by the rectangle's size.
+				const Rectangle hitbox = GetHitbox(x, y);
+				const Rectangle extended(hitbox.x - rectangle.w, hitbox.y - rectangle.h,
+					hitbox.w + rectangle.w, hitbox.h + rectangle.h);
 				
-				auto CalcStep = [&](float d, float s)
+				float tNear;
+				glm::vec2 normal;
+				if (extended.IntersectsRay(rectangle.Min(), move, tNear, normal))
 				{
-					if (std::abs(d) < 0.001f)
-						return INFINITY;
-					return ((d > 0 ? (std::floor(s) + 1) : (std::ceil(s) - 1)) - s) / d;
-				};
-				
-				float stepX = CalcStep(dir.x, pos.x);
-				float stepY = CalcStep(dir.y, pos.y);
-				a += std::min(stepX, stepY) + 0.001f;
-			}
+					const float t = std::max(tNear, 0.0f);
+					if (!hit.has_value() || t < hit->t)
+						hit = RayHit { rectangle.Min() + move * t, normal, glm::ivec2(x, y), t };
+				}
+				return false;
+			});
 		}
 		
-		return IsSolid(std::floor(end.x), std::floor(end.y));
+		return hit;
 	}
 	
 	std::pair<bool, float> TileSolidityMap::ClipX(const Rectangle& originRect, float moveX) const
@@ -112,47 +212,36 @@ namespace jm
 		
 		bool wasClipped = false;
 		
-		const int minY = (int)std::floor(oMin.y);
-		const int maxY = (int)std::ceil(oMax.y);
+		int beginX, endX;
 		if (moveX > 0)
 		{
-			const int endX = (int)std::floor(oMax.x + localMove);
-			
-			for (int x = (int)std::floor(oMax.x); x <= endX; x++)
-			{
-				for (int y = minY; y < maxY; y++)
-				{
-					if (IsSolid(x, y))
-					{
-						auto [rClipped, rClippedMove] = Rectangle::ClipX(originRect, m_hitboxes[x + y * m_width], moveX);
-						if (rClipped && std::abs(rClippedMove) < std::abs(clippedMove))
-						{
-							clippedMove = rClippedMove;
-							wasClipped = true;
-						}
-					}
-				}
-			}
+			beginX = (int)std::floor(oMax.x);
+			endX = (int)std::floor(oMax.x + localMove) + 1;
 		}
 		else if (moveX < 0)
 		{
-			const int endX = (int)std::floor(oMin.x + localMove);
-			
-			for (int x = (int)std::floor(oMin.x); x >= endX; x--)
+			beginX = (int)std::floor(oMin.x + localMove);
+			endX = (int)std::floor(oMin.x) + 1;
+		}
+		else
+		{
+			return std::make_pair(false, moveX);
+		}
+		
+		const int minY = (int)std::floor(oMin.y);
+		const int maxY = (int)std::ceil(oMax.y);
+		for (int y = minY; y < maxY; y++)
+		{
+			IterateSolidInRow(y, beginX, endX, [&] (int x)
 			{
-				for (int y = minY; y < maxY; y++)
+				auto [rClipped, rClippedMove] = Rectangle::ClipX(originRect, GetHitbox(x, y), moveX);
+				if (rClipped && std::abs(rClippedMove) < std::abs(clippedMove))
 				{
-					if (IsSolid(x, y))
-					{
-						auto [rClipped, rClippedMove] = Rectangle::ClipX(originRect, m_hitboxes[x + y * m_width], moveX);
-						if (rClipped && std::abs(rClippedMove) < std::abs(clippedMove))
-						{
-							clippedMove = rClippedMove;
-							wasClipped = true;
-						}
-					}
+					clippedMove = rClippedMove;
+					wasClipped = true;
 				}
-			}
+				return false;
+			});
 		}
 		
 		return std::make_pair(wasClipped, clippedMove);
@@ -167,47 +256,36 @@ namespace jm
 		
 		bool wasClipped = false;
 		
-		const int minX = (int)std::floor(oMin.x);
-		const int maxX = (int)std::ceil(oMax.x);
+		int beginY, endY;
 		if (moveY > 0)
 		{
-			const int endY = (int)std::floor(oMax.y + localMove);
-			
-			for (int y = (int)std::floor(oMax.y); y <= endY; y++)
-			{
-				for (int x = minX; x < maxX; x++)
-				{
-					if (IsSolid(x, y))
-					{
-						auto [rClipped, rClippedMove] = Rectangle::ClipY(originRect, m_hitboxes[x + y * m_width], moveY);
-						if (rClipped && std::abs(rClippedMove) < std::abs(clippedMove))
-						{
-							clippedMove = rClippedMove;
-							wasClipped = true;
-						}
-					}
-				}
-			}
+			beginY = (int)std::floor(oMax.y);
+			endY = (int)std::floor(oMax.y + localMove) + 1;
 		}
 		else if (moveY < 0)
 		{
-			const int endY = (int)std::floor(oMin.y + localMove);
-			
-			for (int y = (int)std::floor(oMin.y); y >= endY; y--)
+			beginY = (int)std::floor(oMin.y + localMove);
+			endY = (int)std::floor(oMin.y) + 1;
+		}
+		else
+		{
+			return std::make_pair(false, moveY);
+		}
+		
+		const int minX = (int)std::floor(oMin.x);
+		const int maxX = (int)std::ceil(oMax.x);
+		for (int y = std::max(beginY, 0); y < std::min(endY, (int)m_height); y++)
+		{
+			IterateSolidInRow(y, minX, maxX, [&] (int x)
 			{
-				for (int x = minX; x < maxX; x++)
+				auto [rClipped, rClippedMove] = Rectangle::ClipY(originRect, GetHitbox(x, y), moveY);
+				if (rClipped && std::abs(rClippedMove) < std::abs(clippedMove))
 				{
-					if (IsSolid(x, y))
-					{
-						auto [rClipped, rClippedMove] = Rectangle::ClipY(originRect, m_hitboxes[x + y * m_width], moveY);
-						if (rClipped && std::abs(rClippedMove) < std::abs(clippedMove))
-						{
-							clippedMove = rClippedMove;
-							wasClipped = true;
-						}
-					}
+					clippedMove = rClippedMove;
+					wasClipped = true;
 				}
-			}
+				return false;
+			});
 		}
 		
 		return std::make_pair(wasClipped, clippedMove);
@@ -227,6 +305,354 @@ namespace jm
 		return glm::vec2(moveX, moveY);
 	}
 	
+	void TileSolidityMap::ClipMany(gsl::span<const Rectangle> originRects, gsl::span<const glm::vec2> moves,
+		gsl::span<glm::vec2> movesOut, gsl::span<uint8_t> clippedFlagsOut, uint32_t numThreads) const
+	{
+		const size_t numBodies = originRects.size();
+		if ((size_t)moves.size() != numBodies || (size_t)movesOut.size() != numBodies ||
+		    (!clippedFlagsOut.empty() && (size_t)clippedFlagsOut.size() != numBodies))
+		{
+			Panic("TileSolidityMap::ClipMany span sizes do not match");
+		}
+		
+		auto ClipRange = [&] (size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				bool clippedX, clippedY;
+				movesOut[i] = Clip(originRects[i], moves[i], clippedX, clippedY);
+				if (!clippedFlagsOut.empty())
+				{
+					clippedFlagsOut[i] = (clippedX ? CLIPPED_X : 0) | (clippedY ? CLIPPED_Y : 0);
+				}
+			}
+		};
+		
+		//Small batches are not worth the cost of starting threads
+		constexpr size_t MIN_BODIES_PER_THREAD = 256;
+		const size_t maxThreads = std::max<size_t>(numBodies / MIN_BODIES_PER_THREAD, 1);
+		numThreads = (uint32_t)std::min<size_t>(std::max<uint32_t>(numThreads, 1), maxThreads);
+		
+		//The map is not modified during the query, so ranges of bodies can be clipped in parallel
+		const size_t bodiesPerThread = (numBodies + numThreads - 1) / numThreads;
+		std::vector<std::future<void>> futures;
+		for (uint32_t t = 1; t < numThreads; t++)
+		{
+			const size_t begin = std::min(t * bodiesPerThread, numBodies);
+			const size_t end = std::min(begin + bodiesPerThread, numBodies);
+			futures.push_back(std::async(std::launch::async, ClipRange, begin, end));
+		}
+		
+		ClipRange(0, std::min(bodiesPerThread, numBodies));
+		
+		for (std::future<void>& future : futures)
+			future.get();
+	}
+	
+	/***
+	 * Computes jump distances along a line of tiles for jump point search, moving in the direction given by step (1 or -1).
+	 * Moving along the line, a tile is a jump point if a tile beside it is free while the tile beside the previous tile
+	 * is not, since the free tile can't be reached diagonally without cutting a corner.
+	 * @param isFree Returns whether the tile at a position on the line, offset sideways by -1, 0 or 1, is free.
+	 * @param store Receives the distance for each position on the line.
+	 */
+	template <typename IsFreeTp, typename StoreTp>
+	static void ComputeJumpDistances(int length, int step, IsFreeTp isFree, StoreTp store)
+	{
+		//Distances are computed backwards from the end of the line, so that each tile can continue from the next one
+		int distance = 0;
+		for (int i = step > 0 ? length - 1 : 0; i >= 0 && i < length; i -= step)
+		{
+			const int next = i + step;
+			if (next < 0 || next >= length || !isFree(next, 0))
+				distance = 0;
+			else if ((isFree(next, -1) && !isFree(i, -1)) || (isFree(next, 1) && !isFree(i, 1)))
+				distance = 1;
+			else
+				distance = distance > 0 ? distance + 1 : distance - 1;
+			
+			store(i, distance);
+		}
+	}
+	
+	void TileSolidityMap::UpdateJumpTables() const
+	{
+		if (!m_hasJumpTables)
+		{
+			for (std::vector<int16_t>& distances : m_jumpDistances)
+				distances.resize(m_width * m_height);
+			m_jumpDirtyRows.assign(m_height, true);
+			m_jumpDirtyColumns.assign(m_width, true);
+			m_hasJumpTables = true;
+			m_jumpTablesDirty = true;
+		}
+		
+		if (!m_jumpTablesDirty)
+			return;
+		
+		auto ToStored = [&] (int distance)
+		{
+			return std::abs(distance) > JUMP_DISTANCE_MAX ? JUMP_DISTANCE_CONTINUE : (int16_t)distance;
+		};
+		
+		for (uint32_t y = 0; y < m_height; y++)
+		{
+			if (!m_jumpDirtyRows[y])
+				continue;
+			m_jumpDirtyRows[y] = false;
+			
+			auto IsFree = [&] (int x, int side) { return InRange(x, y + side) && !IsSolidUnchecked(x, y + side); };
+			for (int dirIdx = 0; dirIdx < 2; dirIdx++)
+			{
+				int16_t* distances = &m_jumpDistances[dirIdx][y * m_width];
+				ComputeJumpDistances(m_width, dirIdx == 0 ? 1 : -1, IsFree, [&] (int x, int distance)
+				{
+					distances[x] = ToStored(distance);
+				});
+			}
+		}
+		
+		for (uint32_t x = 0; x < m_width; x++)
+		{
+			if (!m_jumpDirtyColumns[x])
+				continue;
+			m_jumpDirtyColumns[x] = false;
+			
+			auto IsFree = [&] (int y, int side) { return InRange(x + side, y) && !IsSolidUnchecked(x + side, y); };
+			for (int dirIdx = 2; dirIdx < 4; dirIdx++)
+			{
+				int16_t* distances = &m_jumpDistances[dirIdx][x * m_height];
+				ComputeJumpDistances(m_height, dirIdx == 2 ? 1 : -1, IsFree, [&] (int y, int distance)
+				{
+					distances[y] = ToStored(distance);
+				});
+			}
+		}
+		
+		m_jumpTablesDirty = false;
+	}
+	
+	void TileSolidityMap::MarkJumpTablesDirty(int x, int y)
+	{
+		//Jump distances along a row depend on the rows beside it, and likewise for columns
+		for (int i = std::max(y - 1, 0); i <= std::min(y + 1, (int)m_height - 1); i++)
+			m_jumpDirtyRows[i] = true;
+		for (int i = std::max(x - 1, 0); i <= std::min(x + 1, (int)m_width - 1); i++)
+			m_jumpDirtyColumns[i] = true;
+		m_jumpTablesDirty = true;
+	}
+	
+	void TileSolidityMap::UpdateComponents() const
+	{
+		if (m_hasComponents && !m_componentsDirty)
+			return;
+		
+		//Unions each free tile with the free tiles to the left of and above it, using tile indices as labels
+		const uint32_t numTiles = m_width * m_height;
+		m_componentLabels.resize(numTiles);
+		
+		auto Find = [&] (uint32_t idx)
+		{
+			uint32_t root = idx;
+			while (m_componentLabels[root] != root)
+				root = m_componentLabels[root];
+			while (m_componentLabels[idx] != root)
+				idx = std::exchange(m_componentLabels[idx], root);
+			return root;
+		};
+		
+		for (uint32_t y = 0; y < m_height; y++)
+		{
+			for (uint32_t x = 0; x < m_width; x++)
+			{
+				const uint32_t idx = y * m_width + x;
+				if (IsSolidUnchecked(x, y))
+				{
+					m_componentLabels[idx] = NO_COMPONENT;
+					continue;
+				}
+				
+				m_componentLabels[idx] = idx;
+				if (x > 0 && !IsSolidUnchecked(x - 1, y))
+					m_componentLabels[idx] = Find(idx - 1);
+				if (y > 0 && !IsSolidUnchecked(x, y - 1))
+				{
+					const uint32_t upRoot = Find(idx - m_width);
+					const uint32_t root = Find(idx);
+					if (upRoot != root)
+						m_componentLabels[std::max(upRoot, root)] = std::min(upRoot, root);
+				}
+			}
+		}
+		
+		for (uint32_t idx = 0; idx < numTiles; idx++)
+		{
+			if (m_componentLabels[idx] != NO_COMPONENT)
+				m_componentLabels[idx] = Find(idx);
+		}
+		
+		//Replaces the tile indices with consecutive labels. Roots are the first tile in their component,
+		// so each root is relabeled before the other tiles in its component.
+		m_componentSizes.clear();
+		for (uint32_t idx = 0; idx < numTiles; idx++)
+		{
+			const uint32_t root = m_componentLabels[idx];
+			if (root == NO_COMPONENT)
+				continue;
+			
+			if (root == idx)
+			{
+				m_componentLabels[idx] = (uint32_t)m_componentSizes.size();
+				m_componentSizes.push_back(1);
+			}
+			else
+			{
+				m_componentLabels[idx] = m_componentLabels[root];
+				m_componentSizes[m_componentLabels[idx]]++;
+			}
+		}
+		
+		m_componentParents.resize(m_componentSizes.size());
+		for (uint32_t label = 0; label < m_componentParents.size(); label++)
+			m_componentParents[label] = label;
+		
+		m_hasComponents = true;
+		m_componentsDirty = false;
+	}
+	
+	void TileSolidityMap::MergeComponents(uint32_t a, uint32_t b) const
+	{
+		a = FindComponent(a);
+		b = FindComponent(b);
+		if (a == b)
+			return;
+		if (m_componentSizes[a] < m_componentSizes[b])
+			std::swap(a, b);
+		m_componentParents[b] = a;
+		m_componentSizes[a] += m_componentSizes[b];
+	}
+	
+	void TileSolidityMap::UpdateComponentsAt(int x, int y, bool isSolid)
+	{
+		//The tiles around (x, y) in order, so that each tile is next to the previous one
+		static const glm::ivec2 ring[] =
+		{
+			{ 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+		};
+		
+		auto IsFree = [&] (glm::ivec2 offset)
+		{
+			return InRange(x + offset.x, y + offset.y) && !IsSolidUnchecked(x + offset.x, y + offset.y);
+		};
+		
+		const uint32_t idx = y * m_width + x;
+		if (!isSolid)
+		{
+			//The new free tile joins the components of its neighbors
+			uint32_t label = NO_COMPONENT;
+			for (size_t i = 0; i < std::size(ring); i += 2)
+			{
+				if (!IsFree(ring[i]))
+					continue;
+				const uint32_t neighborLabel = m_componentLabels[(y + ring[i].y) * m_width + x + ring[i].x];
+				if (label == NO_COMPONENT)
+					label = neighborLabel;
+				else
+					MergeComponents(label, neighborLabel);
+			}
+			
+			if (label == NO_COMPONENT)
+			{
+				//Labels of components that no longer exist are not reused, so they are eventually cleaned up by a rebuild
+				if (m_componentParents.size() >= m_width * m_height)
+				{
+					m_componentsDirty = true;
+					return;
+				}
+				label = (uint32_t)m_componentParents.size();
+				m_componentParents.push_back(label);
+				m_componentSizes.push_back(0);
+			}
+			
+			m_componentLabels[idx] = label;
+			m_componentSizes[FindComponent(label)]++;
+			return;
+		}
+		
+		m_componentLabels[idx] = NO_COMPONENT;
+		
+		//The component can only be split if its neighbors aren't connected through the ring of tiles around (x, y).
+		//Only horizontal and vertical neighbors count, since the tile doesn't connect to the diagonal ones.
+		size_t start = 0;
+		while (start < std::size(ring) && IsFree(ring[start]))
+			start++;
+		if (start == std::size(ring))
+			return;
+		
+		int numRuns = 0;
+		bool runHasNeighbor = false;
+		for (size_t i = 1; i <= std::size(ring); i++)
+		{
+			const glm::ivec2 offset = ring[(start + i) % std::size(ring)];
+			if (IsFree(offset))
+			{
+				runHasNeighbor |= offset.x == 0 || offset.y == 0;
+			}
+			else
+			{
+				if (runHasNeighbor)
+					numRuns++;
+				runHasNeighbor = false;
+			}
+		}
+		
+		if (numRuns > 1)
+			m_componentsDirty = true;
+	}
+	
+	int TileSolidityMap::JumpDistance(int x, int y, glm::ivec2 dir) const
+	{
+		int skipped = 0;
+		while (true)
+		{
+			int16_t distance;
+			if (dir.y == 0)
+				distance = m_jumpDistances[dir.x > 0 ? 0 : 1][y * m_width + x];
+			else
+				distance = m_jumpDistances[dir.y > 0 ? 2 : 3][x * m_height + y];
+			
+			if (distance != JUMP_DISTANCE_CONTINUE)
+				return distance > 0 ? skipped + distance : distance - skipped;
+			
+			skipped += JUMP_DISTANCE_MAX;
+			x += dir.x * JUMP_DISTANCE_MAX;
+			y += dir.y * JUMP_DISTANCE_MAX;
+		}
+	}
+	
+	bool TileSolidityMap::RegionChangedSince(int x, int y, int width, int height, uint64_t version) const
+	{
+		if (m_version <= version)
+			return false;
+		
+		const int beginX = std::max(x, 0);
+		const int beginY = std::max(y, 0);
+		const int endX = std::min(x + width, (int)m_width);
+		const int endY = std::min(y + height, (int)m_height);
+		if (beginX >= endX || beginY >= endY)
+			return false;
+		
+		for (int by = beginY / (int)VERSION_BLOCK_SIZE; by <= (endY - 1) / (int)VERSION_BLOCK_SIZE; by++)
+		{
+			for (int bx = beginX / (int)VERSION_BLOCK_SIZE; bx <= (endX - 1) / (int)VERSION_BLOCK_SIZE; bx++)
+			{
+				if (m_blockVersions[by * m_versionBlocksPerRow + bx] > version)
+					return true;
+			}
+		}
+		return false;
+	}
+	
 	void TileSolidityMap::DrawCollision(Graphics2D& gfx) const
 	{
 		for (uint32_t y = 0; y < m_height; y++)
@@ -235,7 +661,7 @@ namespace jm
 			{
 				if (IsSolidUnchecked(x, y))
 				{
-					gfx.BorderRect(m_hitboxes[x + m_width * y], glm::vec4(0.5f, 0, 0, 0.5f), 0.5f);
+					gfx.BorderRect(GetHitbox(x, y), glm::vec4(0.5f, 0, 0, 0.5f), 0.5f);
 				}
 			}
 		}
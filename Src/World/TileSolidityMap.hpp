@@ -6,10 +6,51 @@
 
 #include <cstdint>
 #include <vector>
+#include <unordered_map>
+#include <optional>
 #include <glm/glm.hpp>
+#include <gsl/span>
 
 namespace jm
 {
+	struct RayHit
+	{
+		//The point where the ray hit, in world space. For sweeps this is the minimum corner of the moved rectangle.
+		glm::vec2 point;
+		
+		//The surface normal at the hit point, zero if the ray started inside a solid hitbox.
+		glm::vec2 normal;
+		
+		//The tile that was hit.
+		glm::ivec2 cell;
+		
+		//Fraction of the distance from start to end where the hit occurred, between 0 and 1.
+		float t;
+	};
+	
+	namespace detail
+	{
+		JAPI uint64_t NextTileSolidityMapID();
+		
+		//Copies get a new id, so that data cached for one map is never used for another map at the same address.
+		struct TileSolidityMapID
+		{
+			uint64_t value;
+			
+			TileSolidityMapID()
+				: value(NextTileSolidityMapID()) { }
+			
+			TileSolidityMapID(const TileSolidityMapID&)
+				: TileSolidityMapID() { }
+			
+			TileSolidityMapID& operator=(const TileSolidityMapID&)
+			{
+				value = NextTileSolidityMapID();
+				return *this;
+			}
+		};
+	}
+	
 	class JAPI TileSolidityMap
 	{
 	public:
@@ -29,34 +70,156 @@ namespace jm
 		
 		glm::vec2 Clip(Rectangle originRect, glm::vec2 move, bool& clippedX, bool& clippedY) const;
 		
+		static constexpr uint8_t CLIPPED_X = 1;
+		static constexpr uint8_t CLIPPED_Y = 2;
+		
+		/***
+		 * Clips the movement of many rectangles at once, equivalent to calling Clip for each rectangle.
+		 * @param originRects The rectangles to move.
+		 * @param moves The movement of each rectangle.
+		 * @param movesOut Receives the clipped movement of each rectangle.
+		 * @param clippedFlagsOut Receives CLIPPED_X and/or CLIPPED_Y for each rectangle, may be empty.
+		 * @param numThreads The number of threads to split the work across.
+		 */
+		void ClipMany(gsl::span<const Rectangle> originRects, gsl::span<const glm::vec2> moves,
+			gsl::span<glm::vec2> movesOut, gsl::span<uint8_t> clippedFlagsOut, uint32_t numThreads = 1) const;
+		
 		bool IntersectsSolid(const Rectangle& rectangle) const;
 		
+		/***
+		 * Checks whether a line passes through any solid tile. Only tile solidity is considered, not hitboxes.
+		 */
 		bool LineIntersectsSolid(glm::vec2 start, glm::vec2 end) const;
 		
+		/***
+		 * Finds the first solid hitbox intersected by a line segment.
+		 * @return Information about the hit, or an empty optional if the segment doesn't hit anything.
+		 */
+		std::optional<RayHit> Raycast(glm::vec2 start, glm::vec2 end) const;
+		
+		/***
+		 * Finds the first solid hitbox hit when moving a rectangle.
+		 * Hitboxes that the rectangle only touches are not considered hit unless it moves into them.
+		 * @return Information about the hit, or an empty optional if the rectangle can move freely.
+		 */
+		std::optional<RayHit> Sweep(const Rectangle& rectangle, glm::vec2 move) const;
+		
 		void SetIsSolid(int x, int y, bool isSolid)
 		{
 			if (!InRange(x, y))
 				Panic("TileSolidityMap::SetIsSolid out of range");
-			m_isSolid[y * m_width + x] = isSolid;
+			SetIsSolidUnchecked(x, y, isSolid);
 		}
 		
 		void SetIsSolidUnchecked(int x, int y, bool isSolid)
 		{
-			m_isSolid[y * m_width + x] = isSolid;
+			const uint64_t mask = (uint64_t)1 << (x % 64);
+			uint64_t& word = m_isSolid[y * m_wordsPerRow + x / 64];
+			if (((word & mask) != 0) == isSolid)
+				return;
+			word ^= mask;
+			
+			m_version++;
+			m_blockVersions[(y / VERSION_BLOCK_SIZE) * m_versionBlocksPerRow + x / VERSION_BLOCK_SIZE] = m_version;
+			
+			if (m_hasJumpTables)
+				MarkJumpTablesDirty(x, y);
+			if (m_hasComponents && !m_componentsDirty)
+				UpdateComponentsAt(x, y, isSolid);
+		}
+		
+		/***
+		 * Gets a counter that is incremented whenever the solidity of a tile changes.
+		 */
+		uint64_t Version() const
+		{
+			return m_version;
+		}
+		
+		/***
+		 * Gets an id that is unique among all maps that have been created. Copied or assigned maps get a new id,
+		 * so data derived from a map can be identified by the id together with Version.
+		 */
+		uint64_t ID() const
+		{
+			return m_id.value;
 		}
 		
+		/***
+		 * Checks whether the solidity of any tile in a region may have changed since Version returned the given value.
+		 * Changes are tracked in blocks of VERSION_BLOCK_SIZE tiles, so changes close to the region can also be reported.
+		 */
+		bool RegionChangedSince(int x, int y, int width, int height, uint64_t version) const;
+		
+		static constexpr uint32_t VERSION_BLOCK_SIZE = 8;
+		
 		bool IsSolid(int x, int y) const
 		{
 			if (!InRange(x, y))
 				return false;
-			return m_isSolid[y * m_width + x];
+			return IsSolidUnchecked(x, y);
 		}
 		
 		bool IsSolidUnchecked(int x, int y) const
 		{
-			return m_isSolid[y * m_width + x];
+			return (m_isSolid[y * m_wordsPerRow + x / 64] >> (x % 64)) & 1;
+		}
+		
+		/***
+		 * Brings the jump distance tables used for jump point search up to date. The tables are built the first
+		 * time this is called, after that only rows and columns affected by SetIsSolid are recomputed.
+		 * This is called by GridPathFinder, but must be called beforehand if searches on the same map run concurrently.
+		 */
+		void UpdateJumpTables() const;
+		
+		/***
+		 * Gets the distance from a free tile to the next jump point when moving in a straight line.
+		 * UpdateJumpTables must have been called since the map was last modified.
+		 * @param dir The direction to move in, one of the components must be zero and the other 1 or -1.
+		 * @return The number of steps to the next jump point if positive, otherwise the negated number of
+		 *  free tiles before a solid tile or the edge of the map.
+		 */
+		int JumpDistance(int x, int y, glm::ivec2 dir) const;
+		
+		/***
+		 * Brings the connected component labels of free tiles up to date. The labels are built with union-find the
+		 * first time this is called. After that, tiles made free by SetIsSolid are merged into the components around
+		 * them immediately, while tiles made solid only cause the labels to be rebuilt here if they may have split
+		 * a component. This is called by GridPathFinder, but must be called beforehand if searches on the same map
+		 * run concurrently.
+		 */
+		void UpdateComponents() const;
+		
+		/***
+		 * Gets the label of the connected component that a tile belongs to, or NO_COMPONENT for solid tiles.
+		 * Tiles are connected if they are free and next to each other horizontally or vertically, which matches
+		 * the tiles that GridPathFinder can move between since it doesn't cut corners.
+		 * UpdateComponents must have been called since the map was last modified.
+		 */
+		uint32_t ComponentLabel(int x, int y) const
+		{
+			const uint32_t label = m_componentLabels[y * m_width + x];
+			return label == NO_COMPONENT ? NO_COMPONENT : FindComponent(label);
 		}
 		
+		/***
+		 * Checks whether there is a path between two free tiles. UpdateComponents must have been called since
+		 * the map was last modified.
+		 */
+		bool AreConnected(glm::ivec2 a, glm::ivec2 b) const
+		{
+			const uint32_t label = ComponentLabel(a.x, a.y);
+			return label != NO_COMPONENT && label == ComponentLabel(b.x, b.y);
+		}
+		
+		static constexpr uint32_t NO_COMPONENT = UINT32_MAX;
+		
+		/***
+		 * Gets the hitbox of a tile in world space. This is the full tile unless a tile with a smaller hitbox
+		 * has been applied to it.
+		 */
+		Rectangle GetHitbox(int x, int y) const;
+		
 		bool InRange(int x, int y) const
 		{
 			return x >= 0 && y >= 0 && x < (int)m_width && y < (int)m_height;
@@ -90,12 +253,60 @@ namespace jm
 		void DrawCollision(class Graphics2D& gfx) const;
 		
 	private:
+		template <typename CallbackTp>
+		bool IterateSolidInRow(int y, int beginX, int endX, CallbackTp callback) const;
+		
+		void MarkJumpTablesDirty(int x, int y);
+		
+		uint32_t FindComponent(uint32_t label) const
+		{
+			while (m_componentParents[label] != label)
+				label = m_componentParents[label];
+			return label;
+		}
+		
+		void MergeComponents(uint32_t a, uint32_t b) const;
+		void UpdateComponentsAt(int x, int y, bool isSolid);
+		
 		float m_tileWidth = 1;
 		float m_tileHeight = 1;
 		glm::vec2 m_offset;
 		uint32_t m_width;
 		uint32_t m_height;
-		std::vector<bool> m_isSolid;
-		std::vector<Rectangle> m_hitboxes;
+		
+		//Solidity is stored as one bit per tile, each row starts at a new 64-bit word.
+		uint32_t m_wordsPerRow;
+		std::vector<uint64_t> m_isSolid;
+		
+		//Tiles with hitboxes that don't cover the whole tile have their bit set in m_hasCustomHitbox,
+		// and their world space hitbox stored in m_customHitboxes (keyed by y * width + x).
+		std::vector<uint64_t> m_hasCustomHitbox;
+		std::unordered_map<uint32_t, Rectangle> m_customHitboxes;
+		
+		//The value of m_version when a tile in each block of VERSION_BLOCK_SIZE x VERSION_BLOCK_SIZE tiles last changed.
+		uint64_t m_version = 0;
+		uint32_t m_versionBlocksPerRow;
+		detail::TileSolidityMapID m_id;
+		std::vector<uint64_t> m_blockVersions;
+		
+		//Jump distances for the +x, -x, +y and -y directions. The x tables are stored row by row and the y tables
+		// column by column, so that a dirty row or column can be recomputed in one pass.
+		//Distances that don't fit in 16 bits are split into steps of JUMP_DISTANCE_MAX.
+		static constexpr int JUMP_DISTANCE_MAX = INT16_MAX;
+		static constexpr int16_t JUMP_DISTANCE_CONTINUE = INT16_MIN;
+		mutable std::vector<int16_t> m_jumpDistances[4];
+		mutable std::vector<bool> m_jumpDirtyRows;
+		mutable std::vector<bool> m_jumpDirtyColumns;
+		mutable bool m_hasJumpTables = false;
+		mutable bool m_jumpTablesDirty = false;
+		
+		//Component labels for each tile, merged components are linked through m_componentParents (union-find).
+		//Merging the smaller component into the larger one keeps the chains to the root short, and the chains
+		// are only flattened by rebuilds so that lookups don't write to the map.
+		mutable std::vector<uint32_t> m_componentLabels;
+		mutable std::vector<uint32_t> m_componentParents;
+		mutable std::vector<uint32_t> m_componentSizes;
+		mutable bool m_hasComponents = false;
+		mutable bool m_componentsDirty = false;
 	};
 }
@@ -0,0 +1,171 @@
+#include "AssetPack.hpp"
+#include "Utils.hpp"
+
+#include <miniz.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using namespace jm::detail;
+
+//Entries are only compressed if that makes them at least this much smaller. Formats like PNG and OGG
+// are already compressed, and storing them lets the game use them in place from the mapped pack.
+static constexpr double MIN_COMPRESSION_RATIO = 0.9;
+
+struct InputFile
+{
+	std::string name;
+	std::vector<char> data;
+	PackEntry entry;
+};
+
+static bool ReadInputFile(const fs::path& path, std::vector<char>& dataOut)
+{
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream)
+		return false;
+	
+	dataOut.resize((size_t)stream.tellg());
+	stream.seekg(0);
+	stream.read(dataOut.data(), dataOut.size());
+	return (size_t)stream.gcount() == dataOut.size();
+}
+
+static void CompressEntry(InputFile& file)
+{
+	file.entry.compression = PackCompression::Stored;
+	file.entry.uncompressedSize = file.data.size();
+	if (file.data.empty())
+		return;
+	
+	const int flags = tdefl_create_comp_flags_from_zip_params(MZ_BEST_COMPRESSION, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+	size_t compressedSize = 0;
+	void* compressed = tdefl_compress_mem_to_heap(file.data.data(), file.data.size(), &compressedSize, flags);
+	if (compressed == nullptr)
+		return;
+	
+	if (compressedSize < file.data.size() * MIN_COMPRESSION_RATIO)
+	{
+		const char* compressedChars = static_cast<const char*>(compressed);
+		file.data.assign(compressedChars, compressedChars + compressedSize);
+		file.entry.compression = PackCompression::Deflate;
+	}
+	
+	mz_free(compressed);
+}
+
+static uint64_t AlignPackOffset(uint64_t offset)
+{
+	return (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: assetpacker <asset directory> <output pack>\n";
+		return 1;
+	}
+	
+	const fs::path inputDir = argv[1];
+	if (!fs::is_directory(inputDir))
+	{
+		std::cerr << "'" << inputDir.string() << "' is not a directory.\n";
+		return 1;
+	}
+	
+	std::vector<InputFile> files;
+	for (const fs::directory_entry& dirEntry : fs::recursive_directory_iterator(inputDir))
+	{
+		if (!dirEntry.is_regular_file())
+			continue;
+		
+		InputFile& file = files.emplace_back();
+		file.name = fs::relative(dirEntry.path(), inputDir).generic_string();
+		file.entry = { };
+		file.entry.nameHash = jm::HashFNV1a64(file.name);
+		file.entry.nameLength = (uint32_t)file.name.size();
+		
+		if (!ReadInputFile(dirEntry.path(), file.data))
+		{
+			std::cerr << "Error reading '" << dirEntry.path().string() << "'.\n";
+			return 1;
+		}
+		
+		CompressEntry(file);
+		file.entry.dataSize = file.data.size();
+	}
+	
+	std::sort(files.begin(), files.end(), [&] (const InputFile& a, const InputFile& b)
+	{
+		return a.entry.nameHash < b.entry.nameHash;
+	});
+	
+	for (size_t i = 1; i < files.size(); i++)
+	{
+		if (files[i].entry.nameHash == files[i - 1].entry.nameHash)
+		{
+			std::cerr << "Asset names '" << files[i - 1].name << "' and '" << files[i].name << "' have the same hash, "
+				"rename one of them.\n";
+			return 1;
+		}
+	}
+	
+	PackHeader header = { };
+	std::copy_n(PACK_MAGIC, sizeof(PACK_MAGIC), header.magic);
+	header.version = PACK_VERSION;
+	header.numEntries = (uint32_t)files.size();
+	header.namesOffset = sizeof(PackHeader) + files.size() * sizeof(PackEntry);
+	
+	for (InputFile& file : files)
+	{
+		file.entry.nameOffset = (uint32_t)header.namesSize;
+		header.namesSize += file.name.size();
+	}
+	
+	uint64_t dataOffset = header.namesOffset + header.namesSize;
+	for (InputFile& file : files)
+	{
+		dataOffset = AlignPackOffset(dataOffset);
+		file.entry.dataOffset = dataOffset;
+		dataOffset += file.entry.dataSize;
+	}
+	
+	std::ofstream outStream(argv[2], std::ios::binary);
+	if (!outStream)
+	{
+		std::cerr << "Error opening '" << argv[2] << "' for writing.\n";
+		return 1;
+	}
+	
+	outStream.write(reinterpret_cast<const char*>(&header), sizeof(PackHeader));
+	for (const InputFile& file : files)
+		outStream.write(reinterpret_cast<const char*>(&file.entry), sizeof(PackEntry));
+	for (const InputFile& file : files)
+		outStream.write(file.name.data(), file.name.size());
+	
+	uint64_t compressedSize = 0;
+	uint64_t uncompressedSize = 0;
+	for (const InputFile& file : files)
+	{
+		static const char padding[PACK_ALIGNMENT] = { };
+		outStream.write(padding, file.entry.dataOffset - (uint64_t)outStream.tellp());
+		outStream.write(file.data.data(), file.data.size());
+		
+		compressedSize += file.entry.dataSize;
+		uncompressedSize += file.entry.uncompressedSize;
+	}
+	
+	if (!outStream)
+	{
+		std::cerr << "Error writing '" << argv[2] << "'.\n";
+		return 1;
+	}
+	
+	std::cout << "Packed " << files.size() << " assets, " << uncompressedSize << " bytes -> " << compressedSize << " bytes.\n";
+	return 0;
+}
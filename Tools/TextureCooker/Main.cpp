@@ -0,0 +1,45 @@
+#include "Graphics/Texture.hpp"
+
+#include <stb_image.h>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: texturecooker <input image> <output file>\n"
+			"The output can replace the input image in the assets, or be named with the .jtex extension.\n";
+		return 1;
+	}
+	
+	std::vector<char> imageData;
+	{
+		std::ifstream inStream(argv[1], std::ios::binary | std::ios::ate);
+		if (!inStream)
+		{
+			std::cerr << "Error opening '" << argv[1] << "'.\n";
+			return 1;
+		}
+		
+		imageData.resize((size_t)inStream.tellg());
+		inStream.seekg(0);
+		inStream.read(imageData.data(), imageData.size());
+	}
+	
+	//Cooked textures must have the same orientation as images decoded by the Texture2D asset loader
+	stbi_set_flip_vertically_on_load(true);
+	
+	const std::vector<char> cookedData = jm::Texture2D::Cook(imageData, (jm::Texture2D::LoadFlags)0);
+	
+	std::ofstream outStream(argv[2], std::ios::binary);
+	outStream.write(cookedData.data(), cookedData.size());
+	if (!outStream)
+	{
+		std::cerr << "Error writing '" << argv[2] << "'.\n";
+		return 1;
+	}
+	
+	return 0;
+}